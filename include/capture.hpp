@@ -0,0 +1,87 @@
+#pragma once
+
+#include "vulkan/vulkan.hpp"
+
+//std
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <optional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+enum class CaptureFormat
+{
+    Raw,        // one <path>_NNNNNN.raw per frame, pixels as stored in the swapchain
+    PPM,        // one <path>_NNNNNN.ppm per frame, 8-bit RGB
+    RawVideo    // every frame appended to <path>, pixels as stored in the swapchain
+};
+
+// Drains filled readback buffers on a worker thread so Render() never waits on them.
+// The renderer owns the Vulkan objects, the writer only decides which slot is free
+// and waits on the slot fence before encoding its mapped memory.
+class CaptureWriter final
+{
+public:
+    struct Slot
+    {
+        vk::Fence fence;
+        vk::DeviceMemory memory;
+        const void* data;
+        //false when the memory has to be invalidated before data is read
+        bool coherent;
+    };
+
+    CaptureWriter(vk::Device device, std::vector<Slot> slots,
+                  vk::Extent2D extent, vk::Format format,
+                  std::string path, CaptureFormat captureFormat);
+    ~CaptureWriter();
+
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+    //returns nullopt (and counts a dropped frame) when all slots are still in flight
+    std::optional<uint32_t> AcquireSlot();
+    //the slot's copy has been submitted with its fence
+    void Push(uint32_t slot);
+    //the slot was acquired but nothing got submitted for it
+    void ReleaseSlot(uint32_t slot);
+
+    uint64_t DroppedFrames();
+    //frames the worker couldn't write to disk, a full disk or a bad path
+    uint64_t FailedFrames();
+
+private:
+    struct PendingFrame
+    {
+        uint32_t slot;
+        uint64_t frame;
+    };
+
+    vk::Device device_;
+    std::vector<Slot> slots_;
+    vk::Extent2D extent_;
+    bool swapRB_;
+    std::string path_;
+    CaptureFormat captureFormat_;
+    std::ofstream video_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<PendingFrame> pending_;
+    std::vector<uint32_t> freeSlots_;
+    uint64_t frameCount_ = 0;
+    uint64_t droppedCount_ = 0;
+    uint64_t failedCount_ = 0;
+    //worker only
+    bool writeErrorReported_ = false;
+    bool stop_ = false;
+    std::thread worker_;
+
+    void work();
+    bool write(const Slot& slot, uint64_t frame);
+    bool checkWrite(const std::ofstream& file, const std::string& filePath);
+    std::string framePath(uint64_t frame, const char* ext) const;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "vulkan/vulkan.hpp"
+
+//std
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Build switch for VK_EXT_debug_utils object names and command buffer labels.
+// Off, SetName/BeginLabel/EndLabel are empty inlines and cost nothing.
+#ifndef STEPINTOVULKAN_DEBUG_UTILS
+#define STEPINTOVULKAN_DEBUG_UTILS 0
+#endif
+
+struct DebugConfig
+{
+    //VK_LAYER_KHRONOS_validation, skipped with a warning when it isn't installed
+    bool validation = STEPINTOVULKAN_DEBUG_UTILS;
+    //messenger, object names and labels, needs a build with STEPINTOVULKAN_DEBUG_UTILS
+    bool debugUtils = STEPINTOVULKAN_DEBUG_UTILS;
+};
+
+class DebugUtils final
+{
+public:
+    //instance layers and extensions the config asks for and the loader has
+    static void Select(const DebugConfig& config, std::vector<const char*>& layers, std::vector<const char*>& extensions);
+    //after instance creation, creates the messenger when debug utils were selected
+    static void Init(vk::Instance instance);
+    static void Quit(vk::Instance instance);
+
+#if STEPINTOVULKAN_DEBUG_UTILS
+    template<typename T>
+    static void SetName(vk::Device device, T handle, const char* name)
+    {
+        if(!enabled_) return;
+        auto raw = static_cast<typename T::CType>(handle);
+        uint64_t bits = 0;
+        memcpy(&bits, &raw, sizeof(raw));
+        setName(device, VkObjectType(T::objectType), bits, name);
+    }
+    static void BeginLabel(vk::CommandBuffer buf, const char* name);
+    static void EndLabel(vk::CommandBuffer buf);
+#else
+    template<typename T>
+    static void SetName(vk::Device, T, const char*) {}
+    static void BeginLabel(vk::CommandBuffer, const char*) {}
+    static void EndLabel(vk::CommandBuffer) {}
+#endif
+
+private:
+    static bool enabled_;
+    static VkDebugUtilsMessengerEXT messenger_;
+    static PFN_vkSetDebugUtilsObjectNameEXT setObjectName_;
+    static PFN_vkCmdBeginDebugUtilsLabelEXT cmdBeginLabel_;
+    static PFN_vkCmdEndDebugUtilsLabelEXT cmdEndLabel_;
+
+    static void setName(vk::Device device, VkObjectType type, uint64_t handle, const char* name);
+};
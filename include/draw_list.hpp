@@ -0,0 +1,73 @@
+#pragma once
+
+#include "vulkan/vulkan.hpp"
+#include "frame_arena.hpp"
+
+//std
+#include <cstdint>
+#include <unordered_map>
+
+struct DrawItem
+{
+    //null picks the pipeline Render() would bind on its own
+    vk::Pipeline pipeline;
+    //bound at set 0 when not null
+    vk::DescriptorSet descriptorSet;
+    vk::Buffer vertexBuffer;
+    vk::Buffer indexBuffer;
+    vk::IndexType indexType = vk::IndexType::eUint16;
+    uint32_t indexCount = 0;
+    uint32_t firstIndex = 0;
+    int32_t vertexOffset = 0;
+    //0 is the identity record every frame's instance buffer starts with
+    uint32_t firstInstance = 0;
+    uint32_t instanceCount = 1;
+    //lower passes are drawn first, depth orders draws inside a pipeline/set/mesh run
+    uint32_t pass = 0;
+    float depth = 0;
+};
+
+struct DrawStats
+{
+    uint32_t draws = 0;
+    uint32_t pipelineBinds = 0;
+    uint32_t descriptorSetBinds = 0;
+    uint32_t vertexBufferBinds = 0;
+    uint32_t indexBufferBinds = 0;
+    double sortMicroseconds = 0;
+};
+
+// One frame's draws. Each gets a 64-bit key
+//   pass:4 | pipeline:12 | descriptor set:12 | mesh:16 | depth:20
+// so a radix sort groups draws sharing state and recording only binds on change.
+class DrawList final
+{
+public:
+    void Add(const DrawItem& item);
+    bool Empty() const { return count_ == 0; }
+
+    //sorts, records every draw, then empties the list and its arena for the next frame
+    DrawStats Record(vk::CommandBuffer buf, vk::PipelineLayout layout);
+
+    //ids are truncated to their field width, pass clamps and depth is clamped to [0, 1]
+    static uint64_t PackKey(uint32_t pass, uint32_t pipeline, uint32_t set, uint32_t mesh, float depth);
+
+    //LSD radix sort of keys carrying order along, skips bytes every key shares
+    static void RadixSort(uint64_t* keys, uint32_t* order, uint32_t count,
+                          uint64_t* tmpKeys, uint32_t* tmpOrder);
+
+private:
+    FrameArena arena_;
+    DrawItem* items_ = nullptr;
+    uint64_t* keys_ = nullptr;
+    uint32_t count_ = 0;
+    uint32_t capacity_ = 0;
+
+    //small ids for the key fields, stable across frames so equal state sorts together
+    std::unordered_map<uint64_t, uint32_t> pipelineIds_;
+    std::unordered_map<uint64_t, uint32_t> setIds_;
+    std::unordered_map<uint64_t, uint32_t> meshIds_;
+
+    static uint32_t idFor(std::unordered_map<uint64_t, uint32_t>& ids, uint64_t handle, uint32_t bits);
+    void grow();
+};
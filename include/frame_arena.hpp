@@ -0,0 +1,74 @@
+#pragma once
+
+//std
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <type_traits>
+
+// Bump allocator for data that lives exactly one frame. Reset() hands the memory
+// back at once; after a few frames everything fits a single block and a frame
+// allocates nothing from the heap.
+class FrameArena final
+{
+public:
+    explicit FrameArena(size_t blockSize = 64 * 1024)
+        : blockSize_(blockSize)
+    {
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    template<typename T>
+    T* Allocate(size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "arena memory is never destructed");
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    void Reset()
+    {
+        //fold an overflowing frame into one block sized for it
+        if(blocks_.size() > 1)
+        {
+            size_t total = 0;
+            for(auto& block : blocks_) total += block.size;
+            blocks_.clear();
+            blocks_.push_back(Block{std::make_unique<std::byte[]>(total), total});
+        }
+        offset_ = 0;
+    }
+
+private:
+    struct Block
+    {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    size_t blockSize_;
+    std::vector<Block> blocks_;
+    size_t offset_ = 0;
+
+    void* allocate(size_t size, size_t alignment)
+    {
+        if(!blocks_.empty())
+        {
+            size_t aligned = (offset_ + alignment - 1) & ~(alignment - 1);
+            if(aligned + size <= blocks_.back().size)
+            {
+                offset_ = aligned + size;
+                return blocks_.back().data.get() + aligned;
+            }
+        }
+
+        //operator new[] storage is aligned for any fundamental type
+        size_t blockSize = std::max(blockSize_, size);
+        blocks_.push_back(Block{std::make_unique<std::byte[]>(blockSize), blockSize});
+        offset_ = size;
+        return blocks_.back().data.get();
+    }
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "vulkan/vulkan.hpp"
+
+//std
+#include <cstdint>
+
+// Device local buffer for geometry that changes after creation.
+// Renderer::UpdateGeometry stages only the bytes passed to it; the GPU copies
+// them in before the next frame's draws and grows the buffer when a write
+// lands past its capacity.
+struct GeometryBuffer
+{
+    vk::Buffer buffer;
+    vk::DeviceMemory memory;
+    vk::BufferUsageFlags usage;
+    //bytes written so far, what a grow carries over
+    vk::DeviceSize size = 0;
+    vk::DeviceSize capacity = 0;
+};
+
+struct DynamicMesh
+{
+    GeometryBuffer vertices;
+    GeometryBuffer indices;
+    uint32_t indexCount = 0;
+    vk::IndexType indexType = vk::IndexType::eUint16;
+};
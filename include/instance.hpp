@@ -0,0 +1,51 @@
+#pragma once
+
+//std
+#include <array>
+#include <algorithm>
+#include <cstdint>
+
+// Per-instance record read by shader.vert from vertex binding 1.
+// A vertex p is placed at camera * (rotate(p * scale) + position), so animating
+// a sprite only rewrites its 40 byte record, never the mesh.
+
+struct InstanceData
+{
+    float position[2] = {0, 0};
+    float scale[2] = {1, 1};
+    //radians
+    float rotation = 0;
+    //RGBA8 multiplied with the vertex color, see PackColor
+    uint32_t color = 0xFFFFFFFF;
+    //x, y, width, height of the sprite in texture space, mapped over the [-0.5, 0.5] quad
+    float rect[4] = {0, 0, 1, 1};
+};
+
+static_assert(sizeof(InstanceData) == 40, "InstanceData is read with fixed attribute offsets");
+
+//records handed out by Renderer::AllocateInstances for one frame
+struct InstanceSpan
+{
+    InstanceData* data = nullptr;
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
+
+inline uint32_t PackColor(float r, float g, float b, float a = 1)
+{
+    auto unorm = [](float v) { return uint32_t(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f); };
+    return unorm(r) | unorm(g) << 8 | unorm(b) << 16 | unorm(a) << 24;
+}
+
+//column-major like GLSL, maps [left, right] x [top, bottom] onto the Vulkan clip rect
+inline std::array<float, 16> Ortho2D(float left, float right, float top, float bottom)
+{
+    std::array<float, 16> m{};
+    m[0] = 2 / (right - left);
+    m[5] = 2 / (bottom - top);
+    m[10] = 1;
+    m[12] = -(right + left) / (right - left);
+    m[13] = -(bottom + top) / (bottom - top);
+    m[15] = 1;
+    return m;
+}
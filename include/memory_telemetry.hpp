@@ -0,0 +1,100 @@
+#pragma once
+
+#include "vulkan/vulkan.hpp"
+
+//std
+#include <array>
+#include <vector>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
+enum class MemoryCategory : uint32_t
+{
+    Geometry,
+    Texture,
+    RenderTarget,
+    Staging,
+    Readback,
+    Count
+};
+
+struct MemoryHeapStats
+{
+    vk::DeviceSize size = 0;
+    bool deviceLocal = false;
+    //what this renderer allocated
+    vk::DeviceSize liveBytes = 0;
+    uint32_t allocationCount = 0;
+    //VK_EXT_memory_budget view of the whole process, heap size and live bytes without it;
+    //usage is the last refresh plus what this renderer allocated since
+    vk::DeviceSize budget = 0;
+    vk::DeviceSize usage = 0;
+};
+
+struct MemoryCategoryStats
+{
+    vk::DeviceSize liveBytes = 0;
+    uint32_t allocationCount = 0;
+};
+
+struct MemorySnapshot
+{
+    bool hasBudget = false;
+    std::vector<MemoryHeapStats> heaps;
+    std::array<MemoryCategoryStats, size_t(MemoryCategory::Count)> categories;
+};
+
+// Caches the device memory properties and tracks every allocation made through
+// the renderer, per heap and per category. The budget is only re-read by
+// RefreshBudget, the renderer does that once per frame.
+class MemoryTelemetry final
+{
+public:
+    void Init(vk::PhysicalDevice phyDevice, bool budgetSupported);
+
+    const vk::PhysicalDeviceMemoryProperties& Properties() const { return properties_; }
+    bool HasBudget() const { return budgetSupported_; }
+
+    void OnAllocate(vk::DeviceMemory memory, vk::DeviceSize size, uint32_t typeIndex, MemoryCategory category);
+    void OnFree(vk::DeviceMemory memory);
+
+    //re-reads budget and usage, other processes move them
+    void RefreshBudget();
+
+    //bytes the heap of typeIndex is short of to fit size under the budget, 0 if it fits
+    vk::DeviceSize Overcommit(uint32_t typeIndex, vk::DeviceSize size, float headroom);
+
+    MemorySnapshot Snapshot();
+    void Log(std::ostream& os);
+
+private:
+    struct Allocation
+    {
+        vk::DeviceSize size;
+        uint32_t heap;
+        MemoryCategory category;
+    };
+
+    //what the last refresh reported, usage moves from there with our own allocations
+    struct HeapRefresh
+    {
+        vk::DeviceSize usage = 0;
+        vk::DeviceSize liveBytes = 0;
+    };
+
+    vk::PhysicalDevice phyDevice_;
+    vk::PhysicalDeviceMemoryProperties properties_;
+    bool budgetSupported_ = false;
+
+    std::mutex mutex_;
+    std::unordered_map<VkDeviceMemory, Allocation> allocations_;
+    std::vector<MemoryHeapStats> heaps_;
+    std::vector<HeapRefresh> refreshed_;
+    std::array<MemoryCategoryStats, size_t(MemoryCategory::Count)> categories_;
+
+    //refreshes budget and usage, caller holds mutex_
+    void queryBudget();
+    //usage from the last refresh and the live bytes since, caller holds mutex_
+    void updateUsage(uint32_t heap);
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+//std
+#include <cstdint>
+
+// Binary mesh container shared by the renderer and tools/meshconv.
+//
+//   MeshHeader | vertex stream | index stream
+//
+// Both streams start on MeshAlignment boundaries and are stored exactly as the
+// GPU consumes them, so a mapped file is copied into buffers without parsing.
+// Everything is little endian.
+
+constexpr uint32_t MeshMagic = 0x4853454d;  // "MESH"
+constexpr uint32_t MeshVersion = 1;
+constexpr uint64_t MeshAlignment = 16;
+
+struct MeshVertex
+{
+    float position[2];
+    float color[4];
+};
+
+struct MeshHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t vertexStride;  // sizeof(MeshVertex)
+    uint32_t indexCount;
+    uint32_t indexSize;     // 2 or 4 bytes
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t fileSize;
+};
+
+static_assert(sizeof(MeshHeader) % MeshAlignment == 0, "mesh streams must stay aligned after the header");
+
+inline constexpr uint64_t AlignMeshOffset(uint64_t offset)
+{
+    return (offset + MeshAlignment - 1) & ~(MeshAlignment - 1);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "vulkan/vulkan.hpp"
+
+//std
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+enum class BlendMode : uint32_t
+{
+    Opaque,
+    Alpha,
+    Additive
+};
+
+struct SpecConstant
+{
+    uint32_t id;
+    uint32_t value;
+};
+
+//everything that makes one pipeline variant, the hash of this is its cache key
+struct PipelineDesc
+{
+    vk::ShaderModule vertexShader;
+    vk::ShaderModule fragShader;
+    vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+    vk::CullModeFlags cullMode = vk::CullModeFlagBits::eNone;
+    BlendMode blend = BlendMode::Opaque;
+    //32-bit specialization constants, applied to both stages
+    std::vector<SpecConstant> constants;
+
+    bool operator==(const PipelineDesc& other) const;
+};
+
+struct PipelineDescHash
+{
+    size_t operator()(const PipelineDesc& desc) const;
+};
+
+// Compiles pipeline variants on a small worker pool. Get() never blocks on a
+// compile: it returns the caller's fallback until the variant is ready.
+class PipelineManager final
+{
+public:
+    using Builder = std::function<vk::Pipeline(const PipelineDesc&)>;
+
+    PipelineManager(Builder builder, uint32_t workerCount);
+    ~PipelineManager();
+
+    PipelineManager(const PipelineManager&) = delete;
+    PipelineManager& operator=(const PipelineManager&) = delete;
+
+    //first request of a description queues its compile
+    vk::Pipeline Get(const PipelineDesc& desc, vk::Pipeline fallback);
+    //blocks until every queued compile has finished
+    void WaitIdle();
+    //stops the workers and hands over every compiled pipeline for destruction
+    std::vector<vk::Pipeline> Release();
+
+private:
+    enum class State
+    {
+        Queued,
+        Ready,
+        Failed
+    };
+
+    struct Entry
+    {
+        State state = State::Queued;
+        vk::Pipeline pipeline;
+    };
+
+    Builder builder_;
+    std::unordered_map<PipelineDesc, Entry, PipelineDescHash> entries_;
+    std::deque<PipelineDesc> queue_;
+    uint32_t compiling_ = 0;
+    bool stop_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable workCond_;
+    std::condition_variable idleCond_;
+    std::vector<std::thread> workers_;
+
+    void work();
+};
@@ -3,6 +3,15 @@
 #include "vulkan/vulkan.hpp"
 #include "SDL.h"
 #include "SDL_vulkan.h"
+#include "capture.hpp"
+#include "mesh.hpp"
+#include "texture.hpp"
+#include "pipeline_manager.hpp"
+#include "memory_telemetry.hpp"
+#include "draw_list.hpp"
+#include "debug_utils.hpp"
+#include "instance.hpp"
+#include "geometry_buffer.hpp"
 
 //std
 #include <stdexcept>
@@ -12,18 +21,97 @@
 #include <optional>
 #include <fstream>
 #include <limits>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <cstdlib>
+#include <string>
+
+struct Mesh
+{
+    vk::Buffer vertexBuffer;
+    vk::DeviceMemory vertexMem;
+    vk::Buffer indexBuffer;
+    vk::DeviceMemory indexMem;
+    uint32_t indexCount = 0;
+    vk::IndexType indexType = vk::IndexType::eUint16;
+};
 
 class Renderer final
 {
 public:
+    //call before Init, otherwise STEPINTOVULKAN_VALIDATION=0/1 or the build type decides
+    static void SetDebugConfig(const DebugConfig& config);
     static void Init(SDL_Window* window);
+    //headless: renders into one RGBA8 image instead of a swapchain
+    static void InitOffscreen(uint32_t width, uint32_t height);
     static void Quit();
+    //compiled on the calling thread, also the fallback while variants compile
     static void CreatePipeline(vk::ShaderModule vertexShader, vk::ShaderModule frag);
+    //the variant if it's compiled, otherwise queues it and returns the CreatePipeline() one
+    static vk::Pipeline GetPipeline(const PipelineDesc& desc);
+    //variant used by Render() from now on
+    static void SetPipeline(const PipelineDesc& desc);
+    static void WaitPipelines();
+
+    //live bytes per heap and category, plus VK_EXT_memory_budget usage where available
+    static MemorySnapshot GetMemorySnapshot();
+    //logs the snapshot every that many frames, 0 turns it off
+    static void SetMemoryLogInterval(uint32_t frames);
+    //called when an allocation would push its heap over budget, returns the bytes it released
+    using EvictionHandler = std::function<vk::DeviceSize(uint32_t heapIndex, vk::DeviceSize bytes)>;
+    static void SetEvictionHandler(EvictionHandler handler);
+    //fraction of the heap budget allocations may use before eviction kicks in, 0.9 by default
+    static void SetMemoryHeadroom(float fraction);
     static vk::ShaderModule CreateShaderModule(const char* filename);
 
     static void Render();
+
+    //pushed for every draw, column-major like GLSL, identity until set (see Ortho2D)
+    static void SetCamera(const std::array<float, 16>& matrix);
+    //records per frame instance buffer, call before Init
+    static void SetInstanceCapacity(uint32_t count);
+    //room in this frame's mapped instance buffer, fill it in place before Render()
+    static InstanceSpan AllocateInstances(uint32_t count);
     static void WaitIdle();
 
+    //queues a draw for the next Render(), draws are sorted to minimize state changes
+    static void Submit(const DrawItem& item);
+    static void Submit(const Mesh& mesh, uint32_t pass = 0, float depth = 0);
+    static void Submit(const Mesh& mesh, const InstanceSpan& instances, uint32_t pass = 0, float depth = 0);
+    static void Submit(const DynamicMesh& mesh, uint32_t pass = 0, float depth = 0);
+    //binds, draws and sort time of the last recorded frame
+    static DrawStats GetDrawStats();
+
+    //maps a .mesh file (see mesh.hpp) and copies its streams into device local buffers
+    static Mesh LoadMesh(const char* filename);
+    //the mesh drawn by Render(), the built-in quad until set
+    static void SetMesh(const Mesh& mesh);
+    static void DestroyMesh(Mesh& mesh);
+
+    //capacities in bytes, see geometry_buffer.hpp
+    static DynamicMesh CreateDynamicMesh(vk::DeviceSize vertexCapacity, vk::DeviceSize indexCapacity, vk::IndexType indexType);
+    //copied into this frame's staging memory now, into the buffer before the next Render() draws
+    static void UpdateGeometry(GeometryBuffer& buffer, vk::DeviceSize offset, const void* data, vk::DeviceSize size);
+    //buffers are released once the frames that may use them have finished
+    static void DestroyDynamicMesh(DynamicMesh& mesh);
+
+    //PPM or KTX2, block compressed KTX2 levels are uploaded as stored
+    static Texture LoadTexture(const char* filename);
+    //tightly packed RGBA8, mips are generated on the GPU when the format allows blits
+    static Texture CreateTexture(const void* pixels, uint32_t width, uint32_t height, bool srgb);
+    static void DestroyTexture(Texture& texture);
+    static vk::Sampler GetSampler(const SamplerDesc& desc);
+
+    //copy every presented (or offscreen rendered) frame into a readback ring, written to disk on a worker thread
+    static void StartCapture(const char* path, CaptureFormat format);
+    static void StopCapture();
+
+    //tightly packed RGBA8 rows of the offscreen target
+    static std::vector<uint8_t> ReadPixels();
+
 private:
     struct QueueFamilyIndices
     {
@@ -46,6 +134,48 @@ private:
         size_t size;
     };
 
+    struct CaptureSlot
+    {
+        vk::Buffer buffer;
+        vk::DeviceMemory memory;
+        vk::CommandBuffer cmdBuf;
+        vk::Fence fence;
+        void* data;
+        bool coherent;
+    };
+
+    //one instance record buffer per frame, filled by the CPU while the GPU reads the other
+    struct InstanceFrame
+    {
+        vk::Buffer buffer;
+        vk::DeviceMemory memory;
+        InstanceData* data = nullptr;
+        uint32_t count = 0;
+    };
+
+    //staging ring slot for UpdateGeometry, plus buffers waiting for their last frame to finish
+    struct GeometryFrame
+    {
+        vk::Buffer staging;
+        vk::DeviceMemory stagingMem;
+        uint8_t* data = nullptr;
+        vk::DeviceSize capacity = 0;
+        vk::DeviceSize used = 0;
+        std::vector<std::pair<vk::Buffer, vk::DeviceMemory>> retired;
+    };
+
+    struct GeometryCopy
+    {
+        vk::Buffer src;
+        vk::Buffer dst;
+        vk::BufferCopy region;
+        //transfer to transfer barrier first, set around grow copies
+        bool barrier = false;
+    };
+
+    static constexpr uint32_t CaptureSlotCount = 3;
+    static constexpr uint32_t FrameResourceCount = 2;
+
     static QueueFamilyIndices queueIndices_;
     static SwapchainRequiredInfo requiredInfo_;
 
@@ -68,12 +198,34 @@ private:
     static vk::Semaphore imageAvaliableSem_;
     static vk::Semaphore renderFinishSem_;
     static vk::Fence fence_;
-    static vk::Buffer vertexBuffer_;
-    static vk::DeviceMemory vertexMem_;
-    static vk::Buffer deviceBuffer_;
-    static vk::DeviceMemory deviceMem_;
-    static vk::Buffer indexBuffer_;
-    static vk::DeviceMemory indexMem_;
+    static Mesh quadMesh_;
+    static Mesh mesh_;
+    static vk::Semaphore captureFinishSem_;
+    static std::vector<CaptureSlot> captureSlots_;
+    static std::unique_ptr<CaptureWriter> captureWriter_;
+    static vk::DeviceMemory offscreenMem_;
+    static std::unordered_map<SamplerDesc, vk::Sampler, SamplerDescHash> samplers_;
+    static vk::PipelineCache pipelineCache_;
+    static std::unique_ptr<PipelineManager> pipelineManager_;
+    static std::optional<PipelineDesc> activePipeline_;
+    static MemoryTelemetry memoryTelemetry_;
+    static bool memoryBudget_;
+    static EvictionHandler evictionHandler_;
+    static float memoryHeadroom_;
+    static uint32_t memoryLogInterval_;
+    static uint64_t frameCount_;
+    static DrawList drawList_;
+    static DrawStats drawStats_;
+    static std::optional<DebugConfig> debugConfig_;
+    static std::array<float, 16> camera_;
+    static std::array<InstanceFrame, FrameResourceCount> instanceFrames_;
+    static uint32_t instanceCapacity_;
+    static uint32_t frameIndex_;
+    static std::array<GeometryFrame, FrameResourceCount> geometryFrames_;
+    static std::vector<GeometryCopy> geometryCopies_;
+    static bool geometryBarrier_;
+
+    static void initResources();
 
     static vk::Instance createInstance(const std::vector<const char*> extensions);
     static vk::SurfaceKHR createSurface(SDL_Window* window);
@@ -82,16 +234,41 @@ private:
     static vk::SwapchainKHR createSwapchain();
     static std::vector<vk::ImageView> createImageViews();
     static vk::PipelineLayout createLayout();
+    static vk::Pipeline buildPipeline(const PipelineDesc& desc);
     static vk::RenderPass createRenderPass();
     static std::vector<vk::Framebuffer> createFramebuffers();
     static vk::CommandPool createCmdPool();
     static vk::CommandBuffer createCmdBuffer();
     static vk::Fence createFence();
-    static vk::Buffer createBuffer(vk::BufferUsageFlags flag);
-    static vk::DeviceMemory allocateMem(vk::Buffer buffer, vk::MemoryPropertyFlags flag);
-    static MemRequiredInfo queryMemInfo(vk::Buffer buffer, vk::MemoryPropertyFlags flag);
+    static vk::Buffer createBuffer(vk::DeviceSize size, vk::BufferUsageFlags flag);
+    static vk::DeviceMemory allocateMem(vk::Buffer buffer, vk::MemoryPropertyFlags flag, MemoryCategory category);
+    static vk::DeviceMemory allocateMem(vk::Image image, vk::MemoryPropertyFlags flag, MemoryCategory category);
+    static vk::DeviceMemory allocateMem(vk::MemoryRequirements requirement, vk::MemoryPropertyFlags flag, MemoryCategory category);
+    static vk::DeviceMemory allocateReadbackMem(vk::Buffer buffer, bool& coherent);
+    static void freeMem(vk::DeviceMemory memory);
+    static std::optional<uint32_t> findMemType(vk::MemoryRequirements requirement, vk::MemoryPropertyFlags flag);
+    static MemRequiredInfo queryMemInfo(vk::MemoryRequirements requirement, vk::MemoryPropertyFlags flag);
+    static vk::Image createOffscreenImage();
+    static InstanceFrame createInstanceFrame();
+    static void createGeometryBuffer(GeometryBuffer& buffer, vk::DeviceSize capacity);
+    static void growGeometryBuffer(GeometryBuffer& buffer, vk::DeviceSize required);
+    static vk::DeviceSize stageGeometry(const void* data, vk::DeviceSize size);
+    static void recordGeometryCopies(vk::CommandBuffer buf);
+    static void releaseGeometryFrame(GeometryFrame& frame);
+    static Mesh createMesh(const void* vertexData, vk::DeviceSize vertexSize,
+                           const void* indexData, uint32_t indexCount, vk::IndexType indexType);
+    static vk::CommandBuffer beginOneTimeCmd();
+    static void endOneTimeCmd(vk::CommandBuffer buf);
+    static bool canGenerateMips(vk::Format format);
+    static Texture uploadTexture(vk::Format format, vk::Extent2D extent, uint32_t mipLevels, bool generateMips,
+                                 const void* data, vk::DeviceSize size, const std::vector<vk::BufferImageCopy>& regions);
+    static void recordMipChain(vk::CommandBuffer buf, const Texture& texture);
 
+    static vk::Pipeline currentPipeline();
     static void recordCmd(vk::CommandBuffer buf, vk::Framebuffer fbo);
+    static void present(uint32_t imageIndex);
+    static bool submitCapture(vk::Image image);
+    static void recordCaptureCmd(vk::CommandBuffer buf, vk::Image image, vk::Buffer dst);
 
     static QueueFamilyIndices queuePhysicalDevice();
     static SwapchainRequiredInfo querySwapchainRequiredInfo(int w, int h);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "vulkan/vulkan.hpp"
+
+//std
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+struct Texture
+{
+    vk::Image image;
+    vk::DeviceMemory memory;
+    vk::ImageView view;
+    vk::Format format = vk::Format::eUndefined;
+    vk::Extent2D extent;
+    uint32_t mipLevels = 0;
+};
+
+//samplers are shared, Renderer::GetSampler() creates one per distinct description
+struct SamplerDesc
+{
+    vk::Filter magFilter = vk::Filter::eLinear;
+    vk::Filter minFilter = vk::Filter::eLinear;
+    vk::SamplerMipmapMode mipmapMode = vk::SamplerMipmapMode::eLinear;
+    vk::SamplerAddressMode addressMode = vk::SamplerAddressMode::eRepeat;
+
+    bool operator==(const SamplerDesc& other) const
+    {
+        return magFilter == other.magFilter && minFilter == other.minFilter
+            && mipmapMode == other.mipmapMode && addressMode == other.addressMode;
+    }
+};
+
+struct SamplerDescHash
+{
+    size_t operator()(const SamplerDesc& desc) const
+    {
+        //every field fits in a byte
+        uint32_t key = uint32_t(desc.magFilter)
+                     | uint32_t(desc.minFilter) << 8
+                     | uint32_t(desc.mipmapMode) << 16
+                     | uint32_t(desc.addressMode) << 24;
+        return std::hash<uint32_t>()(key);
+    }
+};
@@ -1,9 +1,12 @@
 #version 450
 
-layout (location = 0) in vec3 outColor;
+layout (location = 0) in vec4 outColor;
 layout (location = 0) out vec4 FragColor;
 
+//scales the color per pipeline variant, see PipelineDesc::constants
+layout (constant_id = 0) const float tint = 1.0;
+
 void main()
 {
-    FragColor = vec4(outColor, 1);
+    FragColor = vec4(outColor.rgb * tint, outColor.a);
 }
\ No newline at end of file
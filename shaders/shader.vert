@@ -1,12 +1,31 @@
 #version 450
 
+layout (push_constant) uniform PushConstants
+{
+    mat4 camera;
+} pc;
+
 layout (location = 0) in vec2 inPos;
 layout (location = 1) in vec3 inColor;
-layout (location = 0) out vec3 outColor;
+
+//per instance, see include/instance.hpp
+layout (location = 2) in vec2 inTranslate;
+layout (location = 3) in vec2 inScale;
+layout (location = 4) in float inRotation;
+layout (location = 5) in vec4 inTint;
+layout (location = 6) in vec4 inRect;
+
+layout (location = 0) out vec4 outColor;
+layout (location = 1) out vec2 outUV;
 
 
 void main()
 {
-    gl_Position = vec4(inPos, 0, 1);
-    outColor = inColor;
+    vec2 scaled = inPos * inScale;
+    float c = cos(inRotation);
+    float s = sin(inRotation);
+    vec2 world = vec2(c * scaled.x - s * scaled.y, s * scaled.x + c * scaled.y) + inTranslate;
+    gl_Position = pc.camera * vec4(world, 0, 1);
+    outColor = vec4(inColor * inTint.rgb, inTint.a);
+    outUV = inRect.xy + (inPos + 0.5) * inRect.zw;
 }
\ No newline at end of file
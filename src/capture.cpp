@@ -0,0 +1,198 @@
+#include "capture.hpp"
+
+//std
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+CaptureWriter::CaptureWriter(vk::Device device, std::vector<Slot> slots,
+                             vk::Extent2D extent, vk::Format format,
+                             std::string path, CaptureFormat captureFormat)
+    : device_(device),
+      slots_(std::move(slots)),
+      extent_(extent),
+      swapRB_(format == vk::Format::eB8G8R8A8Srgb || format == vk::Format::eB8G8R8A8Unorm),
+      path_(std::move(path)),
+      captureFormat_(captureFormat)
+{
+    if(captureFormat_ == CaptureFormat::RawVideo)
+    {
+        video_.open(path_, std::ios::binary | std::ios::out | std::ios::trunc);
+        if(!video_)
+        {
+            throw std::runtime_error("capture file open failed");
+        }
+        std::cout << "Capture raw video " << extent_.width << "x" << extent_.height
+                  << (swapRB_ ? " bgra" : " rgba") << " -> " << path_ << std::endl;
+    }
+
+    for(uint32_t i = 0; i < slots_.size(); i ++)
+    {
+        freeSlots_.push_back(i);
+    }
+
+    worker_ = std::thread(&CaptureWriter::work, this);
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_one();
+    worker_.join();
+
+    if(video_.is_open())
+    {
+        video_.close();
+        if(!checkWrite(video_, path_)) failedCount_ ++;
+    }
+
+    if(droppedCount_)
+    {
+        std::cout << "Capture dropped " << droppedCount_ << " frames" << std::endl;
+    }
+    if(failedCount_)
+    {
+        std::cerr << "Capture failed to write " << failedCount_ << " frames" << std::endl;
+    }
+}
+
+std::optional<uint32_t> CaptureWriter::AcquireSlot()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(freeSlots_.empty())
+    {
+        droppedCount_ ++;
+        return std::nullopt;
+    }
+    uint32_t slot = freeSlots_.back();
+    freeSlots_.pop_back();
+    return slot;
+}
+
+void CaptureWriter::Push(uint32_t slot)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back({slot, frameCount_ ++});
+    }
+    cond_.notify_one();
+}
+
+void CaptureWriter::ReleaseSlot(uint32_t slot)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    freeSlots_.push_back(slot);
+}
+
+uint64_t CaptureWriter::DroppedFrames()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return droppedCount_;
+}
+
+uint64_t CaptureWriter::FailedFrames()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failedCount_;
+}
+
+void CaptureWriter::work()
+{
+    while(true)
+    {
+        PendingFrame frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this]{ return stop_ || !pending_.empty(); });
+            //keep draining after stop so every submitted frame reaches the disk
+            if(pending_.empty()) break;
+            frame = pending_.front();
+            pending_.pop_front();
+        }
+
+        const Slot& slot = slots_[frame.slot];
+        if(device_.waitForFences(slot.fence, true, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess)
+        {
+            std::cerr << "capture wait fence failed" << std::endl;
+        }
+        else
+        {
+            //host cached readback memory isn't always coherent, the copy has to be made visible
+            if(!slot.coherent)
+            {
+                device_.invalidateMappedMemoryRanges(vk::MappedMemoryRange(slot.memory, 0, VK_WHOLE_SIZE));
+            }
+            if(!write(slot, frame.frame))
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                failedCount_ ++;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        freeSlots_.push_back(frame.slot);
+    }
+}
+
+bool CaptureWriter::write(const Slot& slot, uint64_t frame)
+{
+    size_t size = size_t(extent_.width) * extent_.height * 4;
+    auto pixels = static_cast<const char*>(slot.data);
+
+    switch(captureFormat_)
+    {
+    case CaptureFormat::RawVideo:
+        video_.write(pixels, size);
+        return checkWrite(video_, path_);
+
+    case CaptureFormat::Raw:
+    {
+        std::string filePath = framePath(frame, "raw");
+        std::ofstream file(filePath, std::ios::binary | std::ios::out);
+        file.write(pixels, size);
+        file.close();
+        return checkWrite(file, filePath);
+    }
+
+    case CaptureFormat::PPM:
+    {
+        std::vector<char> rgb(size_t(extent_.width) * extent_.height * 3);
+        for(size_t i = 0, j = 0; i < size; i += 4, j += 3)
+        {
+            rgb[j + 0] = pixels[i + (swapRB_ ? 2 : 0)];
+            rgb[j + 1] = pixels[i + 1];
+            rgb[j + 2] = pixels[i + (swapRB_ ? 0 : 2)];
+        }
+        std::string filePath = framePath(frame, "ppm");
+        std::ofstream file(filePath, std::ios::binary | std::ios::out);
+        file << "P6\n" << extent_.width << " " << extent_.height << "\n255\n";
+        file.write(rgb.data(), rgb.size());
+        file.close();
+        return checkWrite(file, filePath);
+    }
+    }
+    return false;
+}
+
+bool CaptureWriter::checkWrite(const std::ofstream& file, const std::string& filePath)
+{
+    if(file) return true;
+    //a full disk fails every following frame too, one line is enough
+    if(!writeErrorReported_)
+    {
+        std::cerr << "capture write to " << filePath << " failed" << std::endl;
+        writeErrorReported_ = true;
+    }
+    return false;
+}
+
+std::string CaptureWriter::framePath(uint64_t frame, const char* ext) const
+{
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), "_%06llu.%s", static_cast<unsigned long long>(frame), ext);
+    return path_ + suffix;
+}
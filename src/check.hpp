@@ -0,0 +1,10 @@
+#pragma once
+
+//std
+#include <stdexcept>
+
+#define CHECK_NULL(expr) \
+if(!(expr))\
+{\
+    throw std::runtime_error(#expr "is nullptr!");\
+}
@@ -0,0 +1,138 @@
+#include "debug_utils.hpp"
+
+//std
+#include <iostream>
+#include <string>
+
+bool DebugUtils::enabled_ = false;
+VkDebugUtilsMessengerEXT DebugUtils::messenger_ = VK_NULL_HANDLE;
+PFN_vkSetDebugUtilsObjectNameEXT DebugUtils::setObjectName_ = nullptr;
+PFN_vkCmdBeginDebugUtilsLabelEXT DebugUtils::cmdBeginLabel_ = nullptr;
+PFN_vkCmdEndDebugUtilsLabelEXT DebugUtils::cmdEndLabel_ = nullptr;
+
+namespace
+{
+
+const char* ValidationLayer = "VK_LAYER_KHRONOS_validation";
+
+VKAPI_ATTR VkBool32 VKAPI_CALL messageCallback(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+                                               VkDebugUtilsMessageTypeFlagsEXT,
+                                               const VkDebugUtilsMessengerCallbackDataEXT* data,
+                                               void*)
+{
+    auto& os = severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT ? std::cerr : std::cout;
+    os << "[vulkan] " << data->pMessage << std::endl;
+    return VK_FALSE;
+}
+
+}
+
+void DebugUtils::Select(const DebugConfig& config, std::vector<const char*>& layers, std::vector<const char*>& extensions)
+{
+    enabled_ = false;
+
+    if(config.validation)
+    {
+        bool found = false;
+        for(auto& layer : vk::enumerateInstanceLayerProperties())
+        {
+            if(std::string(layer.layerName.data()) == ValidationLayer) found = true;
+        }
+        if(found)
+        {
+            layers.push_back(ValidationLayer);
+        }
+        else
+        {
+            std::cerr << ValidationLayer << " isn't installed, running without validation" << std::endl;
+        }
+    }
+
+#if STEPINTOVULKAN_DEBUG_UTILS
+    if(config.debugUtils)
+    {
+        for(auto& ext : vk::enumerateInstanceExtensionProperties())
+        {
+            if(std::string(ext.extensionName.data()) == VK_EXT_DEBUG_UTILS_EXTENSION_NAME) enabled_ = true;
+        }
+        if(enabled_)
+        {
+            extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+        }
+    }
+#endif
+}
+
+void DebugUtils::Init(vk::Instance instance)
+{
+    if(!enabled_) return;
+
+    //extension entry points aren't exported by the loader
+    auto getProc = [instance](const char* name)
+    {
+        return vkGetInstanceProcAddr(static_cast<VkInstance>(instance), name);
+    };
+    auto createMessenger = reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(getProc("vkCreateDebugUtilsMessengerEXT"));
+    setObjectName_ = reinterpret_cast<PFN_vkSetDebugUtilsObjectNameEXT>(getProc("vkSetDebugUtilsObjectNameEXT"));
+    cmdBeginLabel_ = reinterpret_cast<PFN_vkCmdBeginDebugUtilsLabelEXT>(getProc("vkCmdBeginDebugUtilsLabelEXT"));
+    cmdEndLabel_ = reinterpret_cast<PFN_vkCmdEndDebugUtilsLabelEXT>(getProc("vkCmdEndDebugUtilsLabelEXT"));
+    if(!createMessenger || !setObjectName_ || !cmdBeginLabel_ || !cmdEndLabel_)
+    {
+        enabled_ = false;
+        return;
+    }
+
+    VkDebugUtilsMessengerCreateInfoEXT info{};
+    info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+    info.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT
+                         | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    info.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT
+                     | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT
+                     | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+    info.pfnUserCallback = messageCallback;
+    if(createMessenger(static_cast<VkInstance>(instance), &info, nullptr, &messenger_) != VK_SUCCESS)
+    {
+        messenger_ = VK_NULL_HANDLE;
+    }
+}
+
+void DebugUtils::Quit(vk::Instance instance)
+{
+    if(messenger_ != VK_NULL_HANDLE)
+    {
+        auto destroyMessenger = reinterpret_cast<PFN_vkDestroyDebugUtilsMessengerEXT>(
+            vkGetInstanceProcAddr(static_cast<VkInstance>(instance), "vkDestroyDebugUtilsMessengerEXT"));
+        destroyMessenger(static_cast<VkInstance>(instance), messenger_, nullptr);
+        messenger_ = VK_NULL_HANDLE;
+    }
+    enabled_ = false;
+}
+
+#if STEPINTOVULKAN_DEBUG_UTILS
+void DebugUtils::BeginLabel(vk::CommandBuffer buf, const char* name)
+{
+    if(!enabled_) return;
+
+    VkDebugUtilsLabelEXT label{};
+    label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+    label.pLabelName = name;
+    cmdBeginLabel_(static_cast<VkCommandBuffer>(buf), &label);
+}
+
+void DebugUtils::EndLabel(vk::CommandBuffer buf)
+{
+    if(!enabled_) return;
+
+    cmdEndLabel_(static_cast<VkCommandBuffer>(buf));
+}
+#endif
+
+void DebugUtils::setName(vk::Device device, VkObjectType type, uint64_t handle, const char* name)
+{
+    VkDebugUtilsObjectNameInfoEXT info{};
+    info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+    info.objectType = type;
+    info.objectHandle = handle;
+    info.pObjectName = name;
+    setObjectName_(static_cast<VkDevice>(device), &info);
+}
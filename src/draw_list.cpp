@@ -0,0 +1,197 @@
+#include "draw_list.hpp"
+
+//std
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+
+constexpr uint32_t PassBits = 4;
+constexpr uint32_t PipelineBits = 12;
+constexpr uint32_t SetBits = 12;
+constexpr uint32_t MeshBits = 16;
+constexpr uint32_t DepthBits = 20;
+static_assert(PassBits + PipelineBits + SetBits + MeshBits + DepthBits == 64, "sort key must fill 64 bits");
+
+//dispatchable and 32-bit non-dispatchable handles are smaller than 64 bits
+template<typename T>
+uint64_t handleBits(T handle)
+{
+    auto raw = static_cast<typename T::CType>(handle);
+    uint64_t bits = 0;
+    memcpy(&bits, &raw, sizeof(raw));
+    return bits;
+}
+
+}
+
+uint32_t DrawList::idFor(std::unordered_map<uint64_t, uint32_t>& ids, uint64_t handle, uint32_t bits)
+{
+    //ids only steer ordering, a wrapped id costs a redundant bind at worst
+    if(ids.size() >= (size_t(4) << bits))
+    {
+        ids.clear();
+    }
+    auto it = ids.find(handle);
+    if(it != ids.end())
+    {
+        return it->second;
+    }
+    uint32_t id = uint32_t(ids.size()) & ((1u << bits) - 1);
+    ids.emplace(handle, id);
+    return id;
+}
+
+void DrawList::grow()
+{
+    uint32_t capacity = std::max<uint32_t>(capacity_ * 2, 256);
+    auto items = arena_.Allocate<DrawItem>(capacity);
+    auto keys = arena_.Allocate<uint64_t>(capacity);
+    if(count_)
+    {
+        memcpy(items, items_, sizeof(DrawItem) * count_);
+        memcpy(keys, keys_, sizeof(uint64_t) * count_);
+    }
+    items_ = items;
+    keys_ = keys;
+    capacity_ = capacity;
+}
+
+void DrawList::Add(const DrawItem& item)
+{
+    if(count_ == capacity_)
+    {
+        grow();
+    }
+
+    uint32_t pipeline = idFor(pipelineIds_, handleBits(item.pipeline), PipelineBits);
+    uint32_t set = item.descriptorSet ? idFor(setIds_, handleBits(item.descriptorSet), SetBits) : 0;
+    uint32_t mesh = idFor(meshIds_, handleBits(item.vertexBuffer) ^ (handleBits(item.indexBuffer) << 1), MeshBits);
+
+    keys_[count_] = PackKey(item.pass, pipeline, set, mesh, item.depth);
+    items_[count_] = item;
+    count_ ++;
+}
+
+uint64_t DrawList::PackKey(uint32_t pass, uint32_t pipeline, uint32_t set, uint32_t mesh, float depth)
+{
+    uint64_t passBits = std::min<uint32_t>(pass, (1u << PassBits) - 1);
+    uint64_t depthBits = uint64_t(std::clamp(depth, 0.0f, 1.0f) * float((1u << DepthBits) - 1));
+
+    return passBits << (64 - PassBits)
+         | uint64_t(pipeline & ((1u << PipelineBits) - 1)) << (SetBits + MeshBits + DepthBits)
+         | uint64_t(set & ((1u << SetBits) - 1)) << (MeshBits + DepthBits)
+         | uint64_t(mesh & ((1u << MeshBits) - 1)) << DepthBits
+         | depthBits;
+}
+
+DrawStats DrawList::Record(vk::CommandBuffer buf, vk::PipelineLayout layout)
+{
+    DrawStats stats;
+
+    auto sortBegin = std::chrono::steady_clock::now();
+    auto order = arena_.Allocate<uint32_t>(count_);
+    auto tmpKeys = arena_.Allocate<uint64_t>(count_);
+    auto tmpOrder = arena_.Allocate<uint32_t>(count_);
+    for(uint32_t i = 0; i < count_; i ++) order[i] = i;
+    RadixSort(keys_, order, count_, tmpKeys, tmpOrder);
+    stats.sortMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sortBegin).count();
+
+    vk::Pipeline boundPipeline;
+    vk::DescriptorSet boundSet;
+    vk::Buffer boundVertex;
+    vk::Buffer boundIndex;
+    vk::IndexType boundIndexType = vk::IndexType::eUint16;
+    for(uint32_t i = 0; i < count_; i ++)
+    {
+        const DrawItem& item = items_[order[i]];
+        if(item.pipeline != boundPipeline)
+        {
+            buf.bindPipeline(vk::PipelineBindPoint::eGraphics, item.pipeline);
+            boundPipeline = item.pipeline;
+            stats.pipelineBinds ++;
+        }
+        if(item.descriptorSet && item.descriptorSet != boundSet)
+        {
+            buf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 0, item.descriptorSet, nullptr);
+            boundSet = item.descriptorSet;
+            stats.descriptorSetBinds ++;
+        }
+        if(item.vertexBuffer != boundVertex)
+        {
+            vk::DeviceSize offset = 0;
+            buf.bindVertexBuffers(0, item.vertexBuffer, offset);
+            boundVertex = item.vertexBuffer;
+            stats.vertexBufferBinds ++;
+        }
+        if(item.indexBuffer != boundIndex || item.indexType != boundIndexType)
+        {
+            buf.bindIndexBuffer(item.indexBuffer, 0, item.indexType);
+            boundIndex = item.indexBuffer;
+            boundIndexType = item.indexType;
+            stats.indexBufferBinds ++;
+        }
+        buf.drawIndexed(item.indexCount, item.instanceCount, item.firstIndex, item.vertexOffset, item.firstInstance);
+        stats.draws ++;
+    }
+
+    items_ = nullptr;
+    keys_ = nullptr;
+    count_ = 0;
+    capacity_ = 0;
+    arena_.Reset();
+
+    return stats;
+}
+
+void DrawList::RadixSort(uint64_t* keys, uint32_t* order, uint32_t count,
+                         uint64_t* tmpKeys, uint32_t* tmpOrder)
+{
+    if(count < 2) return;
+
+    //all eight histograms in one pass over the keys
+    uint32_t histograms[8][256] = {};
+    for(uint32_t i = 0; i < count; i ++)
+    {
+        for(uint32_t byte = 0; byte < 8; byte ++)
+        {
+            histograms[byte][(keys[i] >> (byte * 8)) & 0xFF] ++;
+        }
+    }
+
+    uint64_t* srcKeys = keys;
+    uint32_t* srcOrder = order;
+    uint64_t* dstKeys = tmpKeys;
+    uint32_t* dstOrder = tmpOrder;
+    for(uint32_t byte = 0; byte < 8; byte ++)
+    {
+        uint32_t* histogram = histograms[byte];
+        //a byte every key shares doesn't change the order
+        if(histogram[(srcKeys[0] >> (byte * 8)) & 0xFF] == count) continue;
+
+        uint32_t offset = 0;
+        for(uint32_t bucket = 0; bucket < 256; bucket ++)
+        {
+            uint32_t size = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += size;
+        }
+        for(uint32_t i = 0; i < count; i ++)
+        {
+            uint32_t slot = histogram[(srcKeys[i] >> (byte * 8)) & 0xFF] ++;
+            dstKeys[slot] = srcKeys[i];
+            dstOrder[slot] = srcOrder[i];
+        }
+        std::swap(srcKeys, dstKeys);
+        std::swap(srcOrder, dstOrder);
+    }
+
+    //an odd number of scatter passes leaves the result in the temporaries
+    if(srcKeys != keys)
+    {
+        memcpy(keys, srcKeys, sizeof(uint64_t) * count);
+        memcpy(order, srcOrder, sizeof(uint32_t) * count);
+    }
+}
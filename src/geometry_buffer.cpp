@@ -0,0 +1,199 @@
+#include "renderer.hpp"
+#include "check.hpp"
+
+namespace
+{
+
+//smallest staging slot, most frames only touch a few ranges
+constexpr vk::DeviceSize MinStagingSize = 64 * 1024;
+//zero sized buffers aren't allowed
+constexpr vk::DeviceSize MinGeometrySize = 4;
+
+}
+
+DynamicMesh Renderer::CreateDynamicMesh(vk::DeviceSize vertexCapacity, vk::DeviceSize indexCapacity, vk::IndexType indexType)
+{
+    DynamicMesh mesh;
+    mesh.indexType = indexType;
+    mesh.vertices.usage = vk::BufferUsageFlagBits::eVertexBuffer;
+    mesh.indices.usage = vk::BufferUsageFlagBits::eIndexBuffer;
+    createGeometryBuffer(mesh.vertices, std::max(vertexCapacity, MinGeometrySize));
+    createGeometryBuffer(mesh.indices, std::max(indexCapacity, MinGeometrySize));
+    return mesh;
+}
+
+void Renderer::UpdateGeometry(GeometryBuffer& buffer, vk::DeviceSize offset, const void* data, vk::DeviceSize size)
+{
+    if(size == 0) return;
+
+    if(offset + size > buffer.capacity)
+    {
+        growGeometryBuffer(buffer, offset + size);
+    }
+    vk::DeviceSize srcOffset = stageGeometry(data, size);
+    vk::Buffer staging = geometryFrames_[frameIndex_].staging;
+    buffer.size = std::max(buffer.size, offset + size);
+
+    bool barrier = geometryBarrier_;
+    geometryBarrier_ = false;
+
+    //transfer writes are unordered, a range written twice this frame needs the later copy to wait
+    for(auto it = geometryCopies_.rbegin(); !barrier && it != geometryCopies_.rend(); ++ it)
+    {
+        if(it->dst == buffer.buffer
+           && it->region.dstOffset < offset + size && offset < it->region.dstOffset + it->region.size)
+        {
+            barrier = true;
+        }
+        //copies before a barrier are already ordered against this one
+        if(it->barrier) break;
+    }
+
+    //contiguous writes to the same buffer become one copy
+    if(!barrier && !geometryCopies_.empty())
+    {
+        auto& last = geometryCopies_.back();
+        if(last.src == staging && last.dst == buffer.buffer
+           && last.region.srcOffset + last.region.size == srcOffset
+           && last.region.dstOffset + last.region.size == offset)
+        {
+            last.region.size += size;
+            return;
+        }
+    }
+
+    GeometryCopy copy;
+    copy.src = staging;
+    copy.dst = buffer.buffer;
+    copy.region = vk::BufferCopy(srcOffset, offset, size);
+    copy.barrier = barrier;
+    geometryCopies_.push_back(copy);
+}
+
+void Renderer::DestroyDynamicMesh(DynamicMesh& mesh)
+{
+    //copies queued for the next frame may still target them
+    auto& retired = geometryFrames_[frameIndex_].retired;
+    retired.emplace_back(mesh.vertices.buffer, mesh.vertices.memory);
+    retired.emplace_back(mesh.indices.buffer, mesh.indices.memory);
+    mesh = DynamicMesh{};
+}
+
+void Renderer::Submit(const DynamicMesh& mesh, uint32_t pass, float depth)
+{
+    DrawItem item;
+    item.vertexBuffer = mesh.vertices.buffer;
+    item.indexBuffer = mesh.indices.buffer;
+    item.indexType = mesh.indexType;
+    item.indexCount = mesh.indexCount;
+    item.pass = pass;
+    item.depth = depth;
+    Submit(item);
+}
+
+void Renderer::createGeometryBuffer(GeometryBuffer& buffer, vk::DeviceSize capacity)
+{
+    //transfer src so a grow can copy the old contents over on the GPU
+    buffer.buffer = createBuffer(capacity, buffer.usage | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc);
+    buffer.memory = allocateMem(buffer.buffer, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Geometry);
+    CHECK_NULL(buffer.buffer);
+    CHECK_NULL(buffer.memory);
+    device_.bindBufferMemory(buffer.buffer, buffer.memory, 0);
+    buffer.capacity = capacity;
+}
+
+void Renderer::growGeometryBuffer(GeometryBuffer& buffer, vk::DeviceSize required)
+{
+    GeometryBuffer grown;
+    grown.usage = buffer.usage;
+    createGeometryBuffer(grown, std::max(buffer.capacity * 2, required));
+    grown.size = buffer.size;
+
+    if(buffer.size)
+    {
+        //after the copies already queued into the old buffer, before any into the new one
+        GeometryCopy copy;
+        copy.src = buffer.buffer;
+        copy.dst = grown.buffer;
+        copy.region = vk::BufferCopy(0, 0, buffer.size);
+        copy.barrier = true;
+        geometryCopies_.push_back(copy);
+        geometryBarrier_ = true;
+    }
+    geometryFrames_[frameIndex_].retired.emplace_back(buffer.buffer, buffer.memory);
+
+    buffer = grown;
+}
+
+vk::DeviceSize Renderer::stageGeometry(const void* data, vk::DeviceSize size)
+{
+    auto& frame = geometryFrames_[frameIndex_];
+    if(frame.used + size > frame.capacity)
+    {
+        //copies queued this frame still read the old staging buffer
+        if(frame.staging)
+        {
+            device_.unmapMemory(frame.stagingMem);
+            frame.retired.emplace_back(frame.staging, frame.stagingMem);
+        }
+        frame.capacity = std::max({frame.capacity * 2, frame.used + size, MinStagingSize});
+        frame.used = 0;
+        frame.staging = createBuffer(frame.capacity, vk::BufferUsageFlagBits::eTransferSrc);
+        frame.stagingMem = allocateMem(frame.staging, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, MemoryCategory::Staging);
+        CHECK_NULL(frame.staging);
+        CHECK_NULL(frame.stagingMem);
+        device_.bindBufferMemory(frame.staging, frame.stagingMem, 0);
+        frame.data = static_cast<uint8_t*>(device_.mapMemory(frame.stagingMem, 0, frame.capacity));
+    }
+
+    vk::DeviceSize offset = frame.used;
+    memcpy(frame.data + offset, data, size);
+    frame.used += size;
+    return offset;
+}
+
+void Renderer::recordGeometryCopies(vk::CommandBuffer buf)
+{
+    if(geometryCopies_.empty()) return;
+
+    DebugUtils::BeginLabel(buf, "geometry upload");
+
+    //earlier frames may still be fetching the ranges about to be overwritten
+    buf.pipelineBarrier(vk::PipelineStageFlagBits::eVertexInput, vk::PipelineStageFlagBits::eTransfer,
+                        {}, nullptr, nullptr, nullptr);
+
+    vk::MemoryBarrier transferDone;
+    transferDone.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+                .setDstAccessMask(vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite);
+    for(auto& copy : geometryCopies_)
+    {
+        if(copy.barrier)
+        {
+            buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+                                {}, transferDone, nullptr, nullptr);
+        }
+        buf.copyBuffer(copy.src, copy.dst, copy.region);
+    }
+
+    vk::MemoryBarrier toVertexInput;
+    toVertexInput.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+                 .setDstAccessMask(vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead);
+    buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eVertexInput,
+                        {}, toVertexInput, nullptr, nullptr);
+
+    DebugUtils::EndLabel(buf);
+
+    geometryCopies_.clear();
+    geometryBarrier_ = false;
+}
+
+void Renderer::releaseGeometryFrame(GeometryFrame& frame)
+{
+    for(auto& [buffer, memory] : frame.retired)
+    {
+        freeMem(memory);
+        device_.destroyBuffer(buffer);
+    }
+    frame.retired.clear();
+    frame.used = 0;
+}
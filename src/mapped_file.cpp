@@ -0,0 +1,73 @@
+#include "mapped_file.hpp"
+
+//std
+#include <stdexcept>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const char* filename)
+{
+#ifdef _WIN32
+    file_ = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file_ == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error(std::string("file open failed: ") + filename);
+    }
+    LARGE_INTEGER size;
+    GetFileSizeEx(file_, &size);
+    size_ = size_t(size.QuadPart);
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(mapping_)
+    {
+        data_ = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    }
+#else
+    fd_ = open(filename, O_RDONLY);
+    if(fd_ < 0)
+    {
+        throw std::runtime_error(std::string("file open failed: ") + filename);
+    }
+    struct stat st;
+    fstat(fd_, &st);
+    size_ = size_t(st.st_size);
+    data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if(data_ == MAP_FAILED)
+    {
+        data_ = nullptr;
+    }
+    else
+    {
+        //assets are read front to back exactly once
+        madvise(data_, size_, MADV_SEQUENTIAL);
+    }
+#endif
+    if(!data_)
+    {
+        close();
+        throw std::runtime_error(std::string("file map failed: ") + filename);
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if(data_) UnmapViewOfFile(data_);
+    if(mapping_) CloseHandle(mapping_);
+    if(file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#else
+    if(data_) munmap(data_, size_);
+    if(fd_ >= 0) ::close(fd_);
+#endif
+    data_ = nullptr;
+}
@@ -0,0 +1,164 @@
+#include "memory_telemetry.hpp"
+
+//std
+#include <algorithm>
+#include <iomanip>
+
+namespace
+{
+
+const char* categoryName(MemoryCategory category)
+{
+    switch(category)
+    {
+    case MemoryCategory::Geometry: return "geometry";
+    case MemoryCategory::Texture: return "texture";
+    case MemoryCategory::RenderTarget: return "render target";
+    case MemoryCategory::Staging: return "staging";
+    case MemoryCategory::Readback: return "readback";
+    default: return "unknown";
+    }
+}
+
+double toMiB(vk::DeviceSize bytes)
+{
+    return double(bytes) / (1024.0 * 1024.0);
+}
+
+}
+
+void MemoryTelemetry::Init(vk::PhysicalDevice phyDevice, bool budgetSupported)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    phyDevice_ = phyDevice;
+    budgetSupported_ = budgetSupported;
+    properties_ = phyDevice_.getMemoryProperties();
+
+    allocations_.clear();
+    categories_ = {};
+    heaps_.assign(properties_.memoryHeapCount, MemoryHeapStats{});
+    refreshed_.assign(properties_.memoryHeapCount, HeapRefresh{});
+    for(uint32_t i = 0; i < properties_.memoryHeapCount; i ++)
+    {
+        heaps_[i].size = properties_.memoryHeaps[i].size;
+        heaps_[i].deviceLocal = bool(properties_.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+    }
+    queryBudget();
+}
+
+void MemoryTelemetry::OnAllocate(vk::DeviceMemory memory, vk::DeviceSize size, uint32_t typeIndex, MemoryCategory category)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    uint32_t heap = properties_.memoryTypes[typeIndex].heapIndex;
+    allocations_[static_cast<VkDeviceMemory>(memory)] = {size, heap, category};
+
+    heaps_[heap].liveBytes += size;
+    heaps_[heap].allocationCount ++;
+    categories_[size_t(category)].liveBytes += size;
+    categories_[size_t(category)].allocationCount ++;
+    updateUsage(heap);
+}
+
+void MemoryTelemetry::OnFree(vk::DeviceMemory memory)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = allocations_.find(static_cast<VkDeviceMemory>(memory));
+    if(it == allocations_.end()) return;
+
+    auto& allocation = it->second;
+    heaps_[allocation.heap].liveBytes -= allocation.size;
+    heaps_[allocation.heap].allocationCount --;
+    categories_[size_t(allocation.category)].liveBytes -= allocation.size;
+    categories_[size_t(allocation.category)].allocationCount --;
+    updateUsage(allocation.heap);
+    allocations_.erase(it);
+}
+
+void MemoryTelemetry::RefreshBudget()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    queryBudget();
+}
+
+vk::DeviceSize MemoryTelemetry::Overcommit(uint32_t typeIndex, vk::DeviceSize size, float headroom)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto& heap = heaps_[properties_.memoryTypes[typeIndex].heapIndex];
+    auto limit = vk::DeviceSize(double(heap.budget) * headroom);
+    return heap.usage + size > limit ? heap.usage + size - limit : 0;
+}
+
+MemorySnapshot MemoryTelemetry::Snapshot()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    MemorySnapshot snapshot;
+    snapshot.hasBudget = budgetSupported_;
+    snapshot.heaps = heaps_;
+    snapshot.categories = categories_;
+    return snapshot;
+}
+
+void MemoryTelemetry::Log(std::ostream& os)
+{
+    auto snapshot = Snapshot();
+
+    os << std::fixed << std::setprecision(1);
+    for(size_t i = 0; i < snapshot.heaps.size(); i ++)
+    {
+        auto& heap = snapshot.heaps[i];
+        os << "Memory heap " << i << (heap.deviceLocal ? " (device local)" : " (host)")
+           << ": " << toMiB(heap.liveBytes) << " MiB in " << heap.allocationCount << " allocations, "
+           << (snapshot.hasBudget ? "usage " : "live ") << toMiB(heap.usage)
+           << " / " << (snapshot.hasBudget ? "budget " : "heap ") << toMiB(heap.budget) << " MiB" << std::endl;
+    }
+    for(size_t i = 0; i < snapshot.categories.size(); i ++)
+    {
+        auto& category = snapshot.categories[i];
+        if(category.allocationCount == 0) continue;
+        os << "  " << categoryName(MemoryCategory(i)) << ": " << toMiB(category.liveBytes)
+           << " MiB in " << category.allocationCount << " allocations" << std::endl;
+    }
+    os << std::defaultfloat;
+}
+
+void MemoryTelemetry::queryBudget()
+{
+    if(!budgetSupported_)
+    {
+        for(size_t i = 0; i < heaps_.size(); i ++)
+        {
+            heaps_[i].budget = heaps_[i].size;
+            refreshed_[i] = {heaps_[i].liveBytes, heaps_[i].liveBytes};
+            heaps_[i].usage = heaps_[i].liveBytes;
+        }
+        return;
+    }
+
+    auto chain = phyDevice_.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+    auto& budget = chain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+    for(size_t i = 0; i < heaps_.size(); i ++)
+    {
+        heaps_[i].budget = budget.heapBudget[i];
+        refreshed_[i] = {budget.heapUsage[i], heaps_[i].liveBytes};
+        heaps_[i].usage = budget.heapUsage[i];
+    }
+}
+
+void MemoryTelemetry::updateUsage(uint32_t heap)
+{
+    auto& stats = heaps_[heap];
+    auto& refreshed = refreshed_[heap];
+    if(stats.liveBytes >= refreshed.liveBytes)
+    {
+        stats.usage = refreshed.usage + (stats.liveBytes - refreshed.liveBytes);
+    }
+    else
+    {
+        stats.usage = refreshed.usage - std::min(refreshed.usage, refreshed.liveBytes - stats.liveBytes);
+    }
+}
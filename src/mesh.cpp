@@ -0,0 +1,71 @@
+#include "renderer.hpp"
+#include "mapped_file.hpp"
+
+namespace
+{
+
+//the largest index, streams start on MeshAlignment so they can be read in place
+template<typename T>
+uint32_t maxIndex(const char* data, uint32_t count)
+{
+    auto indices = reinterpret_cast<const T*>(data);
+    T result = 0;
+    for(uint32_t i = 0; i < count; i ++)
+    {
+        result = std::max(result, indices[i]);
+    }
+    return result;
+}
+
+}
+
+Mesh Renderer::LoadMesh(const char* filename)
+{
+    MappedFile file(filename);
+
+    if(file.Size() < sizeof(MeshHeader))
+    {
+        throw std::runtime_error("mesh file truncated");
+    }
+    MeshHeader header;
+    memcpy(&header, file.Data(), sizeof(header));
+
+    if(header.magic != MeshMagic || header.version != MeshVersion)
+    {
+        throw std::runtime_error("not a mesh file or unsupported version");
+    }
+    if(header.vertexStride != sizeof(MeshVertex) || (header.indexSize != 2 && header.indexSize != 4))
+    {
+        throw std::runtime_error("mesh stream layout doesn't match the renderer");
+    }
+
+    //zero sized buffers aren't allowed
+    if(header.vertexCount == 0 || header.indexCount == 0)
+    {
+        throw std::runtime_error("mesh has an empty stream");
+    }
+
+    //counts are 32 bit so the sizes can't overflow, offsets are checked without adding to them
+    uint64_t vertexSize = uint64_t(header.vertexCount) * header.vertexStride;
+    uint64_t indexSize = uint64_t(header.indexCount) * header.indexSize;
+    if(header.fileSize != file.Size()
+       || header.vertexOffset % MeshAlignment || header.indexOffset % MeshAlignment
+       || header.vertexOffset > file.Size() || vertexSize > file.Size() - header.vertexOffset
+       || header.indexOffset > file.Size() || indexSize > file.Size() - header.indexOffset)
+    {
+        throw std::runtime_error("mesh streams out of file bounds");
+    }
+
+    //an index past the vertex stream would make the GPU fetch outside the vertex buffer
+    const char* indexData = file.Data() + header.indexOffset;
+    uint32_t largest = header.indexSize == 2 ? maxIndex<uint16_t>(indexData, header.indexCount)
+                                             : maxIndex<uint32_t>(indexData, header.indexCount);
+    if(largest >= header.vertexCount)
+    {
+        throw std::runtime_error("mesh index out of vertex range");
+    }
+
+    return createMesh(file.Data() + header.vertexOffset, vertexSize,
+                      indexData, header.indexCount,
+                      header.indexSize == 2 ? vk::IndexType::eUint16 : vk::IndexType::eUint32);
+}
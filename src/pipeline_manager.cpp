@@ -0,0 +1,145 @@
+#include "pipeline_manager.hpp"
+
+//std
+#include <iostream>
+
+bool PipelineDesc::operator==(const PipelineDesc& other) const
+{
+    if(vertexShader != other.vertexShader || fragShader != other.fragShader
+       || topology != other.topology || cullMode != other.cullMode || blend != other.blend
+       || constants.size() != other.constants.size())
+    {
+        return false;
+    }
+    for(size_t i = 0; i < constants.size(); i ++)
+    {
+        if(constants[i].id != other.constants[i].id || constants[i].value != other.constants[i].value)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t PipelineDescHash::operator()(const PipelineDesc& desc) const
+{
+    //FNV-1a over the fields
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](uint64_t value)
+    {
+        for(int i = 0; i < 8; i ++)
+        {
+            hash ^= (value >> (i * 8)) & 0xFF;
+            hash *= 1099511628211ull;
+        }
+    };
+
+    mix(uint64_t(static_cast<VkShaderModule>(desc.vertexShader)));
+    mix(uint64_t(static_cast<VkShaderModule>(desc.fragShader)));
+    mix(uint64_t(desc.topology));
+    mix(uint64_t(static_cast<VkCullModeFlags>(desc.cullMode)));
+    mix(uint64_t(desc.blend));
+    for(auto& constant : desc.constants)
+    {
+        mix(uint64_t(constant.id) << 32 | constant.value);
+    }
+    return size_t(hash);
+}
+
+PipelineManager::PipelineManager(Builder builder, uint32_t workerCount)
+    : builder_(std::move(builder))
+{
+    for(uint32_t i = 0; i < workerCount; i ++)
+    {
+        workers_.emplace_back(&PipelineManager::work, this);
+    }
+}
+
+PipelineManager::~PipelineManager()
+{
+    Release();
+}
+
+vk::Pipeline PipelineManager::Get(const PipelineDesc& desc, vk::Pipeline fallback)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(desc);
+    if(it == entries_.end())
+    {
+        entries_.emplace(desc, Entry{});
+        queue_.push_back(desc);
+        workCond_.notify_one();
+        return fallback;
+    }
+    return it->second.state == State::Ready ? it->second.pipeline : fallback;
+}
+
+void PipelineManager::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    idleCond_.wait(lock, [this]{ return queue_.empty() && compiling_ == 0; });
+}
+
+std::vector<vk::Pipeline> PipelineManager::Release()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        //queued compiles aren't worth finishing, in-flight ones are waited below
+        queue_.clear();
+    }
+    workCond_.notify_all();
+    idleCond_.notify_all();
+    for(auto& worker : workers_)
+    {
+        worker.join();
+    }
+    workers_.clear();
+
+    std::vector<vk::Pipeline> pipelines;
+    for(auto& entry : entries_)
+    {
+        if(entry.second.state == State::Ready)
+        {
+            pipelines.push_back(entry.second.pipeline);
+        }
+    }
+    entries_.clear();
+    return pipelines;
+}
+
+void PipelineManager::work()
+{
+    while(true)
+    {
+        PipelineDesc desc;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            workCond_.wait(lock, [this]{ return stop_ || !queue_.empty(); });
+            if(stop_) break;
+            desc = std::move(queue_.front());
+            queue_.pop_front();
+            compiling_ ++;
+        }
+
+        Entry result;
+        try
+        {
+            result.pipeline = builder_(desc);
+            result.state = State::Ready;
+        }
+        catch(const std::exception& e)
+        {
+            //keeps serving the fallback instead of retrying every frame
+            std::cerr << "pipeline variant compile failed: " << e.what() << std::endl;
+            result.state = State::Failed;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            entries_[desc] = result;
+            compiling_ --;
+        }
+        idleCond_.notify_all();
+    }
+}
@@ -1,10 +1,5 @@
 #include "renderer.hpp"
-
-#define CHECK_NULL(expr) \
-if(!(expr))\
-{\
-    throw std::runtime_error(#expr "is nullptr!");\
-}
+#include "check.hpp"
 
 vk::Instance Renderer::instance_ = nullptr;
 vk::SurfaceKHR Renderer::surface_ = nullptr;
@@ -27,12 +22,35 @@ vk::CommandBuffer Renderer::cmdBuf_ = nullptr;
 vk::Semaphore Renderer::imageAvaliableSem_ = nullptr;
 vk::Semaphore Renderer::renderFinishSem_ = nullptr;
 vk::Fence Renderer::fence_ = nullptr;
-vk::Buffer Renderer::vertexBuffer_ = nullptr;
-vk::DeviceMemory Renderer::vertexMem_ = nullptr;
-vk::Buffer Renderer::deviceBuffer_ = nullptr;
-vk::DeviceMemory Renderer::deviceMem_ = nullptr;
-vk::Buffer Renderer::indexBuffer_ = nullptr;
-vk::DeviceMemory Renderer::indexMem_ = nullptr;
+Mesh Renderer::quadMesh_;
+Mesh Renderer::mesh_;
+vk::Semaphore Renderer::captureFinishSem_ = nullptr;
+std::vector<Renderer::CaptureSlot> Renderer::captureSlots_;
+std::unique_ptr<CaptureWriter> Renderer::captureWriter_;
+std::unordered_map<SamplerDesc, vk::Sampler, SamplerDescHash> Renderer::samplers_;
+vk::PipelineCache Renderer::pipelineCache_ = nullptr;
+std::unique_ptr<PipelineManager> Renderer::pipelineManager_;
+std::optional<PipelineDesc> Renderer::activePipeline_;
+MemoryTelemetry Renderer::memoryTelemetry_;
+bool Renderer::memoryBudget_ = false;
+Renderer::EvictionHandler Renderer::evictionHandler_;
+float Renderer::memoryHeadroom_ = 0.9f;
+uint32_t Renderer::memoryLogInterval_ = 0;
+uint64_t Renderer::frameCount_ = 0;
+DrawList Renderer::drawList_;
+DrawStats Renderer::drawStats_;
+vk::DeviceMemory Renderer::offscreenMem_ = nullptr;
+std::optional<DebugConfig> Renderer::debugConfig_;
+std::array<float, 16> Renderer::camera_{1, 0, 0, 0,
+                                        0, 1, 0, 0,
+                                        0, 0, 1, 0,
+                                        0, 0, 0, 1};
+std::array<Renderer::InstanceFrame, Renderer::FrameResourceCount> Renderer::instanceFrames_;
+uint32_t Renderer::instanceCapacity_ = 65536;
+uint32_t Renderer::frameIndex_ = 0;
+std::array<Renderer::GeometryFrame, Renderer::FrameResourceCount> Renderer::geometryFrames_;
+std::vector<Renderer::GeometryCopy> Renderer::geometryCopies_;
+bool Renderer::geometryBarrier_ = false;
 
 struct Vec2
 {
@@ -76,6 +94,51 @@ struct Vertex
     }
 };
 
+//binding 1, advanced once per instance
+struct Instance
+{
+    static vk::VertexInputBindingDescription GetBindingDescription()
+    {
+        vk::VertexInputBindingDescription description;
+        description.setBinding(1)
+                   .setInputRate(vk::VertexInputRate::eInstance)
+                   .setStride(sizeof(InstanceData));
+
+        return description;
+    }
+
+    static std::array<vk::VertexInputAttributeDescription, 5> GetAttrDescription()
+    {
+        std::array<vk::VertexInputAttributeDescription, 5> desc;
+        desc[0].setBinding(1)
+               .setLocation(2)
+               .setFormat(vk::Format::eR32G32Sfloat)
+               .setOffset(offsetof(InstanceData, position));
+        desc[1].setBinding(1)
+               .setLocation(3)
+               .setFormat(vk::Format::eR32G32Sfloat)
+               .setOffset(offsetof(InstanceData, scale));
+        desc[2].setBinding(1)
+               .setLocation(4)
+               .setFormat(vk::Format::eR32Sfloat)
+               .setOffset(offsetof(InstanceData, rotation));
+        desc[3].setBinding(1)
+               .setLocation(5)
+               .setFormat(vk::Format::eR8G8B8A8Unorm)
+               .setOffset(offsetof(InstanceData, color));
+        desc[4].setBinding(1)
+               .setLocation(6)
+               .setFormat(vk::Format::eR32G32B32A32Sfloat)
+               .setOffset(offsetof(InstanceData, rect));
+
+        return desc;
+    }
+};
+
+//.mesh files store vertices exactly like this
+static_assert(sizeof(Vertex) == sizeof(MeshVertex), "Vertex and MeshVertex layouts diverged");
+static_assert(offsetof(Vertex, color) == offsetof(MeshVertex, color), "Vertex and MeshVertex layouts diverged");
+
 std::array vertices
 {   Vertex{{-0.5, -0.5},{1, 0, 0}},
     Vertex{{ 0.5, -0.5},{0, 1, 0}},
@@ -86,6 +149,10 @@ std::array vertices
 std::array<uint16_t, 6> indices {0, 1, 2, 0, 2, 3};
 
 
+void Renderer::SetDebugConfig(const DebugConfig& config)
+{
+    debugConfig_ = config;
+}
 
 void Renderer::Init(SDL_Window* window)
 {
@@ -116,6 +183,7 @@ void Renderer::Init(SDL_Window* window)
 
     device_ = createDevice();
     CHECK_NULL(device_);
+    memoryTelemetry_.Init(phyDevice_, memoryBudget_);
 
     graphicQueue_ = device_.getQueue(queueIndices_.graphicsIndices.value(), 0);
     presentQueue_ = device_.getQueue(queueIndices_.presentIndices.value(), 0);
@@ -130,6 +198,47 @@ void Renderer::Init(SDL_Window* window)
     CHECK_NULL(swapchain_);
 
     images_ = device_.getSwapchainImagesKHR(swapchain_);
+
+    initResources();
+}
+
+void Renderer::InitOffscreen(uint32_t width, uint32_t height)
+{
+    //no surface extensions, the single color target is read back with ReadPixels()
+    instance_ = createInstance({});
+    CHECK_NULL(instance_);
+
+    phyDevice_ = pickupPhysicalDevice();
+    CHECK_NULL(phyDevice_);
+
+    std::cout << "Pickup Device Name " << phyDevice_.getProperties().deviceName << std::endl;
+
+    queueIndices_ = queuePhysicalDevice();
+
+    device_ = createDevice();
+    CHECK_NULL(device_);
+    memoryTelemetry_.Init(phyDevice_, memoryBudget_);
+
+    graphicQueue_ = device_.getQueue(queueIndices_.graphicsIndices.value(), 0);
+    presentQueue_ = graphicQueue_;
+    CHECK_NULL(graphicQueue_);
+
+    requiredInfo_.extent = vk::Extent2D(width, height);
+    requiredInfo_.format = vk::SurfaceFormatKHR(vk::Format::eR8G8B8A8Unorm, vk::ColorSpaceKHR::eSrgbNonlinear);
+    requiredInfo_.imageCount = 1;
+
+    images_.push_back(createOffscreenImage());
+    CHECK_NULL(images_[0]);
+
+    offscreenMem_ = allocateMem(images_[0], vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::RenderTarget);
+    CHECK_NULL(offscreenMem_);
+    device_.bindImageMemory(images_[0], offscreenMem_, 0);
+
+    initResources();
+}
+
+void Renderer::initResources()
+{
     imageViews_ = createImageViews();
 
     layout_ = createLayout();
@@ -138,6 +247,13 @@ void Renderer::Init(SDL_Window* window)
     renderPass_ = createRenderPass();
     CHECK_NULL(renderPass_);
 
+    pipelineCache_ = device_.createPipelineCache(vk::PipelineCacheCreateInfo());
+    CHECK_NULL(pipelineCache_);
+
+    //leave a core for the render thread
+    uint32_t workers = std::clamp<uint32_t>(std::thread::hardware_concurrency() / 2, 1, 4);
+    pipelineManager_ = std::make_unique<PipelineManager>(buildPipeline, workers);
+
     framebuffers_ = createFramebuffers();
     for(auto& framebuffer : framebuffers_)
     {
@@ -152,82 +268,65 @@ void Renderer::Init(SDL_Window* window)
 
     imageAvaliableSem_ = createSemaphore();
     renderFinishSem_ = createSemaphore();
+    captureFinishSem_ = createSemaphore();
     CHECK_NULL(imageAvaliableSem_);
     CHECK_NULL(renderFinishSem_);
+    CHECK_NULL(captureFinishSem_);
 
     fence_ = createFence();
     CHECK_NULL(fence_);
 
-    vertexBuffer_ = createBuffer(vk::BufferUsageFlagBits::eTransferSrc);
-    vertexMem_ = allocateMem(vertexBuffer_, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
-    CHECK_NULL(vertexBuffer_);
-    CHECK_NULL(vertexMem_);
-
-    deviceBuffer_ = createBuffer(vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer);
-    deviceMem_ = allocateMem(deviceBuffer_, vk::MemoryPropertyFlagBits::eDeviceLocal);
-    CHECK_NULL(deviceBuffer_);
-    CHECK_NULL(deviceMem_);
-
-    device_.bindBufferMemory(vertexBuffer_, vertexMem_, 0);
-    device_.bindBufferMemory(deviceBuffer_, deviceMem_, 0);
-    
-    void* data = device_.mapMemory(vertexMem_, 0, sizeof(vertices));
-    memcpy(data, vertices.data(), sizeof(vertices));
-    device_.unmapMemory(vertexMem_);
-
-    vk::CommandBuffer transformCmdBuf = createCmdBuffer();
-    CHECK_NULL(transformCmdBuf);
-
-    vk::CommandBufferBeginInfo info;
-    info.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-
-    transformCmdBuf.begin(info);
-
-    vk::BufferCopy region;
-    region.setDstOffset(0)
-          .setSrcOffset(0)
-          .setSize(sizeof(vertices));
-    transformCmdBuf.copyBuffer(vertexBuffer_, deviceBuffer_, region);
-
-    transformCmdBuf.end();
-
-    vk::SubmitInfo submitInfo;
-    submitInfo.setCommandBuffers(transformCmdBuf);
-
-    graphicQueue_.submit(submitInfo);
-
-    device_.waitIdle();
+    quadMesh_ = createMesh(vertices.data(), sizeof(vertices), indices.data(), indices.size(), vk::IndexType::eUint16);
+    mesh_ = quadMesh_;
 
-    device_.freeCommandBuffers(cmdPool_, transformCmdBuf);
-
-    indexBuffer_ = createBuffer(vk::BufferUsageFlagBits::eIndexBuffer);
-    indexMem_ = allocateMem(indexBuffer_, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
-    CHECK_NULL(indexBuffer_);
-    CHECK_NULL(indexMem_);
-
-    device_.bindBufferMemory(indexBuffer_, indexMem_, 0);
-
-    data = device_.mapMemory(indexMem_, 0, sizeof(indices));
-    memcpy(data, indices.data(), sizeof(indices));
-    device_.unmapMemory(indexMem_);
+    for(auto& frame : instanceFrames_)
+    {
+        frame = createInstanceFrame();
+        DebugUtils::SetName(device_, frame.buffer, "instance records");
+    }
+    frameIndex_ = 0;
 
+    for(auto& image : images_)
+    {
+        DebugUtils::SetName(device_, image, swapchain_ ? "swapchain image" : "offscreen target");
+    }
+    DebugUtils::SetName(device_, renderPass_, "main pass");
+    DebugUtils::SetName(device_, layout_, "pipeline layout");
+    DebugUtils::SetName(device_, cmdBuf_, "frame commands");
+    DebugUtils::SetName(device_, fence_, "frame fence");
+    DebugUtils::SetName(device_, quadMesh_.vertexBuffer, "quad vertices");
+    DebugUtils::SetName(device_, quadMesh_.indexBuffer, "quad indices");
 }
 
 vk::Instance Renderer::createInstance(const std::vector<const char*> extensions)
 {
-    //validation layers
-    std::array<const char*, 1> layers{"VK_LAYER_KHRONOS_validation"};
+    //validation and debug utils are off in release builds unless asked for
+    DebugConfig config;
+    if(debugConfig_)
+    {
+        config = debugConfig_.value();
+    }
+    else if(const char* env = std::getenv("STEPINTOVULKAN_VALIDATION"))
+    {
+        config.validation = config.debugUtils = std::string(env) != "0";
+    }
+
+    std::vector<const char*> layers;
+    std::vector<const char*> enabledExtensions = extensions;
+    DebugUtils::Select(config, layers, enabledExtensions);
 
-    //get all layer names if you forget how to spell them
-    // auto layerNames = vk::enumerateInstanceLayerProperties();
-    // for(auto& layer : layerNames)
-    //     std::cout << layer.layerName << std::endl;
+    //1.1 for vkGetPhysicalDeviceMemoryProperties2, used by the memory budget query
+    vk::ApplicationInfo appInfo;
+    appInfo.setApiVersion(VK_API_VERSION_1_1);
 
     vk::InstanceCreateInfo info;
-    info.setPEnabledExtensionNames(extensions);
+    info.setPApplicationInfo(&appInfo);
+    info.setPEnabledExtensionNames(enabledExtensions);
     info.setPEnabledLayerNames(layers);
 
-    return vk::createInstance(info);
+    vk::Instance instance = vk::createInstance(info);
+    DebugUtils::Init(instance);
+    return instance;
 }
 
 vk::SurfaceKHR Renderer::createSurface(SDL_Window* window)
@@ -251,7 +350,7 @@ Renderer::QueueFamilyIndices Renderer::queuePhysicalDevice()
         {
             indices.graphicsIndices = idx;
         }
-        if(phyDevice_.getSurfaceSupportKHR(idx, surface_))
+        if(!surface_ || phyDevice_.getSurfaceSupportKHR(idx, surface_))
         {
             indices.presentIndices = idx;
         }
@@ -291,7 +390,24 @@ vk::Device Renderer::createDevice()
         queueinfos.push_back(info2);
     }
 
-    std::array<const char*, 1> extensions{VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    std::vector<const char*> extensions;
+    if(surface_)
+    {
+        extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+
+    memoryBudget_ = false;
+    if(phyDevice_.getProperties().apiVersion >= VK_API_VERSION_1_1)
+    {
+        for(auto& ext : phyDevice_.enumerateDeviceExtensionProperties())
+        {
+            if(std::string(ext.extensionName.data()) == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)
+            {
+                memoryBudget_ = true;
+                extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            }
+        }
+    }
     
     vk::DeviceCreateInfo info;
     info.setPEnabledExtensionNames(extensions);
@@ -339,7 +455,14 @@ vk::SwapchainKHR Renderer::createSwapchain()
     info.setSurface(surface_);
     info.setImageArrayLayers(1);
     info.setCompositeAlpha(vk::CompositeAlphaFlagBitsKHR::eOpaque);
-    info.setImageUsage(vk::ImageUsageFlagBits::eColorAttachment);
+
+    //transfer src lets StartCapture() copy the presented images back to the host
+    vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eColorAttachment;
+    if(requiredInfo_.capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc)
+    {
+        usage |= vk::ImageUsageFlagBits::eTransferSrc;
+    }
+    info.setImageUsage(usage);
 
     return device_.createSwapchainKHR(info);
     
@@ -404,12 +527,34 @@ std::vector<vk::ImageView> Renderer::createImageViews()
 
 void Renderer::Quit()
 {
-    device_.freeMemory(vertexMem_);
-    device_.freeMemory(indexMem_);
-    device_.freeMemory(deviceMem_);
-    device_.destroyBuffer(vertexBuffer_);
-    device_.destroyBuffer(deviceBuffer_);
-    device_.destroyBuffer(indexBuffer_);
+    StopCapture();
+    device_.destroySemaphore(captureFinishSem_);
+    for(auto& sampler : samplers_)
+    {
+        device_.destroySampler(sampler.second);
+    }
+    samplers_.clear();
+    DestroyMesh(quadMesh_);
+    for(auto& frame : instanceFrames_)
+    {
+        device_.unmapMemory(frame.memory);
+        freeMem(frame.memory);
+        device_.destroyBuffer(frame.buffer);
+        frame = InstanceFrame{};
+    }
+    for(auto& frame : geometryFrames_)
+    {
+        releaseGeometryFrame(frame);
+        if(frame.staging)
+        {
+            device_.unmapMemory(frame.stagingMem);
+            freeMem(frame.stagingMem);
+            device_.destroyBuffer(frame.staging);
+        }
+        frame = GeometryFrame{};
+    }
+    geometryCopies_.clear();
+    geometryBarrier_ = false;
     device_.destroyFence(fence_);
     device_.destroySemaphore(imageAvaliableSem_);
     device_.destroySemaphore(renderFinishSem_);
@@ -419,41 +564,118 @@ void Renderer::Quit()
     {
         device_.destroyFramebuffer(framebuffer);
     }
+    //joins the workers first, an in-flight variant still builds against renderPass_ and layout_
+    for(auto& pipeline : pipelineManager_->Release())
+    {
+        device_.destroyPipeline(pipeline);
+    }
+    pipelineManager_.reset();
+    activePipeline_.reset();
     device_.destroyRenderPass(renderPass_);
     device_.destroyPipelineLayout(layout_);
     device_.destroyPipeline(pipeline_);
+    device_.destroyPipelineCache(pipelineCache_);
     for(auto& shader : shaderModules_)
     {
         device_.destroyShaderModule(shader);
     }
+    shaderModules_.clear();
     for(auto& view : imageViews_)
     {
         device_.destroyImageView(view);
     }
-    device_.destroySwapchainKHR(swapchain_);
+    if(swapchain_)
+    {
+        device_.destroySwapchainKHR(swapchain_);
+        swapchain_ = nullptr;
+    }
+    else
+    {
+        for(auto& image : images_)
+        {
+            device_.destroyImage(image);
+        }
+        freeMem(offscreenMem_);
+    }
+    images_.clear();
     device_.destroy();
-    instance_.destroySurfaceKHR(surface_);
+    device_ = nullptr;
+    if(surface_)
+    {
+        instance_.destroySurfaceKHR(surface_);
+        surface_ = nullptr;
+    }
+    DebugUtils::Quit(instance_);
     instance_.destroy();
+    instance_ = nullptr;
 }
 
 void Renderer::CreatePipeline(vk::ShaderModule vertexShader, vk::ShaderModule fragShader)
+{
+    PipelineDesc desc;
+    desc.vertexShader = vertexShader;
+    desc.fragShader = fragShader;
+
+    pipeline_ = buildPipeline(desc);
+    DebugUtils::SetName(device_, pipeline_, "default pipeline");
+}
+
+vk::Pipeline Renderer::GetPipeline(const PipelineDesc& desc)
+{
+    return pipelineManager_->Get(desc, pipeline_);
+}
+
+void Renderer::SetPipeline(const PipelineDesc& desc)
+{
+    activePipeline_ = desc;
+    //start compiling right away rather than at the next recordCmd
+    GetPipeline(desc);
+}
+
+void Renderer::WaitPipelines()
+{
+    pipelineManager_->WaitIdle();
+}
+
+//called from the pipeline manager workers as well, only touches state fixed after Init
+vk::Pipeline Renderer::buildPipeline(const PipelineDesc& desc)
 {
     vk::GraphicsPipelineCreateInfo info;
 
+    //Specialization constants, every constant is 32 bits wide
+    std::vector<vk::SpecializationMapEntry> specEntries;
+    std::vector<uint32_t> specData;
+    for(auto& constant : desc.constants)
+    {
+        specEntries.emplace_back(constant.id, uint32_t(specData.size() * sizeof(uint32_t)), sizeof(uint32_t));
+        specData.push_back(constant.value);
+    }
+    vk::SpecializationInfo specInfo;
+    specInfo.setMapEntries(specEntries)
+            .setDataSize(specData.size() * sizeof(uint32_t))
+            .setPData(specData.data());
+
     //Shader configurations
     std::array<vk::PipelineShaderStageCreateInfo, 2> stageInfos;
-    stageInfos[0].setModule(vertexShader)
+    stageInfos[0].setModule(desc.vertexShader)
                  .setStage(vk::ShaderStageFlagBits::eVertex)
                  .setPName("main");
-    stageInfos[1].setModule(fragShader)
+    stageInfos[1].setModule(desc.fragShader)
                  .setStage(vk::ShaderStageFlagBits::eFragment)
                  .setPName("main");
+    if(!specEntries.empty())
+    {
+        stageInfos[0].setPSpecializationInfo(&specInfo);
+        stageInfos[1].setPSpecializationInfo(&specInfo);
+    }
     info.setStages(stageInfos);
     
     //Vertex Input
     vk::PipelineVertexInputStateCreateInfo vertexInput;
-    auto bindingDesc = Vertex::GetBindingDescription();
-    auto attriDesc = Vertex::GetAttrDescription();
+    std::array bindingDesc{Vertex::GetBindingDescription(), Instance::GetBindingDescription()};
+    std::vector<vk::VertexInputAttributeDescription> attriDesc;
+    for(auto& attr : Vertex::GetAttrDescription()) attriDesc.push_back(attr);
+    for(auto& attr : Instance::GetAttrDescription()) attriDesc.push_back(attr);
     vertexInput.setVertexAttributeDescriptions(attriDesc)
                .setVertexBindingDescriptions(bindingDesc);
     info.setPVertexInputState(&vertexInput);
@@ -461,7 +683,7 @@ void Renderer::CreatePipeline(vk::ShaderModule vertexShader, vk::ShaderModule fr
     //Input Assembly
     vk::PipelineInputAssemblyStateCreateInfo inputAsm;
     inputAsm.setPrimitiveRestartEnable(false)
-            .setTopology(vk::PrimitiveTopology::eTriangleList);
+            .setTopology(desc.topology);
     info.setPInputAssemblyState(&inputAsm);
 
     //layout
@@ -483,7 +705,7 @@ void Renderer::CreatePipeline(vk::ShaderModule vertexShader, vk::ShaderModule fr
             .setDepthClampEnable(false)
             .setDepthBiasClamp(false)
             .setLineWidth(1)
-            .setCullMode(vk::CullModeFlagBits::eNone)
+            .setCullMode(desc.cullMode)
             .setPolygonMode(vk::PolygonMode::eFill);
     
     info.setPRasterizationState(&rastInfo);
@@ -504,6 +726,30 @@ void Renderer::CreatePipeline(vk::ShaderModule vertexShader, vk::ShaderModule fr
                                     vk::ColorComponentFlagBits::eG |
                                     vk::ColorComponentFlagBits::eB |
                                     vk::ColorComponentFlagBits::eA);
+    switch(desc.blend)
+    {
+    case BlendMode::Opaque:
+        attBlendState.setBlendEnable(false);
+        break;
+    case BlendMode::Alpha:
+        attBlendState.setBlendEnable(true)
+                     .setSrcColorBlendFactor(vk::BlendFactor::eSrcAlpha)
+                     .setDstColorBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha)
+                     .setColorBlendOp(vk::BlendOp::eAdd)
+                     .setSrcAlphaBlendFactor(vk::BlendFactor::eOne)
+                     .setDstAlphaBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha)
+                     .setAlphaBlendOp(vk::BlendOp::eAdd);
+        break;
+    case BlendMode::Additive:
+        attBlendState.setBlendEnable(true)
+                     .setSrcColorBlendFactor(vk::BlendFactor::eOne)
+                     .setDstColorBlendFactor(vk::BlendFactor::eOne)
+                     .setColorBlendOp(vk::BlendOp::eAdd)
+                     .setSrcAlphaBlendFactor(vk::BlendFactor::eOne)
+                     .setDstAlphaBlendFactor(vk::BlendFactor::eOne)
+                     .setAlphaBlendOp(vk::BlendOp::eAdd);
+        break;
+    }
     colorBlend.setLogicOpEnable(false)
               .setAttachments(attBlendState);
     
@@ -512,14 +758,13 @@ void Renderer::CreatePipeline(vk::ShaderModule vertexShader, vk::ShaderModule fr
     //RenderPass
     info.setRenderPass(renderPass_);
 
-    auto result = device_.createGraphicsPipeline(nullptr, info);
+    auto result = device_.createGraphicsPipeline(pipelineCache_, info);
     if(result.result != vk::Result::eSuccess)
     {
         throw std::runtime_error("pipeline create failed");
     }
 
-    pipeline_ = result.value; 
-
+    return result.value;
 }
 
 vk::ShaderModule Renderer::CreateShaderModule(const char* filename)
@@ -540,7 +785,14 @@ vk::ShaderModule Renderer::CreateShaderModule(const char* filename)
 
 vk::PipelineLayout Renderer::createLayout()
 {
+    //the camera, within the 128 bytes every implementation guarantees
+    vk::PushConstantRange range;
+    range.setStageFlags(vk::ShaderStageFlagBits::eVertex)
+         .setOffset(0)
+         .setSize(sizeof(camera_));
+
     vk::PipelineLayoutCreateInfo info;
+    info.setPushConstantRanges(range);
     return device_.createPipelineLayout(info);
 }
 
@@ -555,7 +807,7 @@ vk::RenderPass Renderer::createRenderPass()
                   .setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
                   .setFormat(requiredInfo_.format.format)
                   .setInitialLayout(vk::ImageLayout::eUndefined)
-                  .setFinalLayout(vk::ImageLayout::ePresentSrcKHR);
+                  .setFinalLayout(swapchain_ ? vk::ImageLayout::ePresentSrcKHR : vk::ImageLayout::eTransferSrcOptimal);
     createInfo.setAttachments(attachmentDesc);
 
     vk::SubpassDescription subpassDesc;
@@ -567,6 +819,16 @@ vk::RenderPass Renderer::createRenderPass()
 
     createInfo.setSubpasses(subpassDesc);
 
+    //the clear's layout transition waits for the last frame's writes and any capture copy still reading the image
+    vk::SubpassDependency dependency;
+    dependency.setSrcSubpass(VK_SUBPASS_EXTERNAL)
+              .setDstSubpass(0)
+              .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eTransfer)
+              .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
+              .setSrcAccessMask({})
+              .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
+    createInfo.setDependencies(dependency);
+
     return device_.createRenderPass(createInfo);
 
 }
@@ -608,6 +870,103 @@ vk::CommandBuffer Renderer::createCmdBuffer()
 
 }
 
+vk::Pipeline Renderer::currentPipeline()
+{
+    return activePipeline_ ? GetPipeline(activePipeline_.value()) : pipeline_;
+}
+
+void Renderer::Submit(const DrawItem& item)
+{
+    if(item.pipeline)
+    {
+        drawList_.Add(item);
+        return;
+    }
+    DrawItem resolved = item;
+    resolved.pipeline = currentPipeline();
+    drawList_.Add(resolved);
+}
+
+void Renderer::Submit(const Mesh& mesh, uint32_t pass, float depth)
+{
+    DrawItem item;
+    item.vertexBuffer = mesh.vertexBuffer;
+    item.indexBuffer = mesh.indexBuffer;
+    item.indexType = mesh.indexType;
+    item.indexCount = mesh.indexCount;
+    item.pass = pass;
+    item.depth = depth;
+    Submit(item);
+}
+
+void Renderer::Submit(const Mesh& mesh, const InstanceSpan& instances, uint32_t pass, float depth)
+{
+    DrawItem item;
+    item.vertexBuffer = mesh.vertexBuffer;
+    item.indexBuffer = mesh.indexBuffer;
+    item.indexType = mesh.indexType;
+    item.indexCount = mesh.indexCount;
+    item.firstInstance = instances.first;
+    item.instanceCount = instances.count;
+    item.pass = pass;
+    item.depth = depth;
+    Submit(item);
+}
+
+void Renderer::SetCamera(const std::array<float, 16>& matrix)
+{
+    camera_ = matrix;
+}
+
+void Renderer::SetInstanceCapacity(uint32_t count)
+{
+    //the instance buffers are sized once, in initResources
+    if(device_)
+    {
+        throw std::runtime_error("SetInstanceCapacity must be called before Init");
+    }
+    //one more for the identity record
+    instanceCapacity_ = count + 1;
+}
+
+InstanceSpan Renderer::AllocateInstances(uint32_t count)
+{
+    auto& frame = instanceFrames_[frameIndex_];
+    if(count > instanceCapacity_ - frame.count)
+    {
+        throw std::runtime_error("instance buffer full, raise SetInstanceCapacity");
+    }
+
+    InstanceSpan span;
+    span.data = frame.data + frame.count;
+    span.first = frame.count;
+    span.count = count;
+    frame.count += count;
+    return span;
+}
+
+Renderer::InstanceFrame Renderer::createInstanceFrame()
+{
+    InstanceFrame frame;
+    vk::DeviceSize size = vk::DeviceSize(instanceCapacity_) * sizeof(InstanceData);
+    frame.buffer = createBuffer(size, vk::BufferUsageFlagBits::eVertexBuffer);
+    frame.memory = allocateMem(frame.buffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, MemoryCategory::Geometry);
+    CHECK_NULL(frame.buffer);
+    CHECK_NULL(frame.memory);
+    device_.bindBufferMemory(frame.buffer, frame.memory, 0);
+
+    //mapped for the buffer's whole life, records are written straight into it
+    frame.data = static_cast<InstanceData*>(device_.mapMemory(frame.memory, 0, size));
+    frame.data[0] = InstanceData{};
+    frame.count = 1;
+    return frame;
+}
+
+DrawStats Renderer::GetDrawStats()
+{
+    return drawStats_;
+}
+
 void Renderer::recordCmd(vk::CommandBuffer buf, vk::Framebuffer fbo)
 {
     vk::CommandBufferBeginInfo beginInfo;
@@ -617,6 +976,10 @@ void Renderer::recordCmd(vk::CommandBuffer buf, vk::Framebuffer fbo)
     {
         throw std::runtime_error("command buffer record failed");
     }
+
+    //transfers can't run inside a render pass
+    recordGeometryCopies(buf);
+
     vk::RenderPassBeginInfo renderPassBegin;
     vk::ClearColorValue cvalue(std::array<float, 4>{0.1, 0.1, 0.1, 1});
     vk::ClearValue value(cvalue);
@@ -624,16 +987,23 @@ void Renderer::recordCmd(vk::CommandBuffer buf, vk::Framebuffer fbo)
                    .setRenderArea(vk::Rect2D({0, 0}, requiredInfo_.extent))
                    .setClearValues(value)
                    .setFramebuffer(fbo);
+    DebugUtils::BeginLabel(buf, "main pass");
     buf.beginRenderPass(renderPassBegin, vk::SubpassContents::eInline);
+
+    //every pipeline shares layout_, so these survive the binds the draw list makes
+    buf.pushConstants<float>(layout_, vk::ShaderStageFlagBits::eVertex, 0, camera_);
+    vk::DeviceSize instanceOffset = 0;
+    buf.bindVertexBuffers(1, instanceFrames_[frameIndex_].buffer, instanceOffset);
     
-    buf.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline_);
-    
-    vk::DeviceSize size = 0;
-    buf.bindVertexBuffers(0, deviceBuffer_, size);
-    buf.bindIndexBuffer(indexBuffer_, 0, vk::IndexType::eUint16);
-    
-    buf.drawIndexed(indices.size(), 1, 0, 0, 0);
+    //nothing submitted this frame keeps the single mesh_ draw
+    if(drawList_.Empty())
+    {
+        Submit(mesh_);
+    }
+    drawStats_ = drawList_.Record(buf, layout_);
+
     buf.endRenderPass();
+    DebugUtils::EndLabel(buf);
 
     buf.end();
 }
@@ -641,41 +1011,414 @@ void Renderer::recordCmd(vk::CommandBuffer buf, vk::Framebuffer fbo)
 void Renderer::Render()
 {
     device_.resetFences(fence_);
-    //acquire a image from swapchain
-    auto result = device_.acquireNextImageKHR(swapchain_, std::numeric_limits<uint64_t>::max(), imageAvaliableSem_, nullptr);
-    if(result.result != vk::Result::eSuccess)
+
+    //offscreen targets have a single image and nothing to acquire or present
+    uint32_t imageIndex = 0;
+    if(swapchain_)
     {
-        throw std::runtime_error("acquire image failed");
+        //acquire a image from swapchain
+        auto result = device_.acquireNextImageKHR(swapchain_, std::numeric_limits<uint64_t>::max(), imageAvaliableSem_, nullptr);
+        if(result.result != vk::Result::eSuccess)
+        {
+            throw std::runtime_error("acquire image failed");
+        }
+        
+        imageIndex = result.value;
     }
-    
-    uint32_t imageIndex = result.value;
 
     cmdBuf_.reset();
     recordCmd(cmdBuf_, framebuffers_[imageIndex]);
  
     vk::PipelineStageFlags flags = vk::PipelineStageFlagBits::eColorAttachmentOutput;
     vk::SubmitInfo submitInfo;
-    submitInfo.setCommandBuffers(cmdBuf_)
-              .setSignalSemaphores(renderFinishSem_)
-              .setWaitSemaphores(imageAvaliableSem_)
-              .setWaitDstStageMask(flags);
+    submitInfo.setCommandBuffers(cmdBuf_);
+    if(swapchain_)
+    {
+        submitInfo.setSignalSemaphores(renderFinishSem_)
+                  .setWaitSemaphores(imageAvaliableSem_)
+                  .setWaitDstStageMask(flags);
+    }
     graphicQueue_.submit(submitInfo, fence_);
 
+    if(swapchain_)
+    {
+        present(imageIndex);
+    }
+    else if(captureWriter_)
+    {
+        submitCapture(images_[0]);
+    }
+
+    if(device_.waitForFences(fence_, true, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess)
+    {
+        throw std::runtime_error("wait fence failed");
+    }
+
+    //this frame's staging and retired buffers are free again,
+    //the next frame fills the other instance and staging buffers
+    releaseGeometryFrame(geometryFrames_[frameIndex_]);
+    frameIndex_ = (frameIndex_ + 1) % FrameResourceCount;
+    instanceFrames_[frameIndex_].count = 1;
+
+    //one budget query per frame, allocations in between add to the cached usage
+    memoryTelemetry_.RefreshBudget();
+    frameCount_ ++;
+    if(memoryLogInterval_ && frameCount_ % memoryLogInterval_ == 0)
+    {
+        memoryTelemetry_.Log(std::cout);
+    }
+}
+
+void Renderer::present(uint32_t imageIndex)
+{
+    vk::Semaphore presentWaitSem = renderFinishSem_;
+    if(captureWriter_ && submitCapture(images_[imageIndex]))
+    {
+        presentWaitSem = captureFinishSem_;
+    }
+
     vk::PresentInfoKHR presentInfo;
     presentInfo.setImageIndices(imageIndex)
                .setSwapchains(swapchain_)
-               .setWaitSemaphores(renderFinishSem_);
+               .setWaitSemaphores(presentWaitSem);
                
     if(presentQueue_.presentKHR(presentInfo) != vk::Result::eSuccess)
     {
         throw std::runtime_error("present failed");
     }
+}
 
-    if(device_.waitForFences(fence_, true, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess)
+bool Renderer::submitCapture(vk::Image image)
+{
+    //readback goes in its own submission so the worker can wait on a per-slot fence,
+    //a frame is dropped instead of stalling when the whole ring is still in flight
+    auto slot = captureWriter_->AcquireSlot();
+    if(!slot) return false;
+
+    auto& capture = captureSlots_[slot.value()];
+    try
     {
-        throw std::runtime_error("wait fence failed");
+        capture.cmdBuf.reset();
+        recordCaptureCmd(capture.cmdBuf, image, capture.buffer);
+        device_.resetFences(capture.fence);
+
+        vk::PipelineStageFlags captureFlags = vk::PipelineStageFlagBits::eTransfer;
+        vk::SubmitInfo captureInfo;
+        captureInfo.setCommandBuffers(capture.cmdBuf);
+        //offscreen frames are ordered by the barriers in recordCaptureCmd alone
+        if(swapchain_)
+        {
+            captureInfo.setWaitSemaphores(renderFinishSem_)
+                       .setWaitDstStageMask(captureFlags)
+                       .setSignalSemaphores(captureFinishSem_);
+        }
+        graphicQueue_.submit(captureInfo, capture.fence);
+    }
+    catch(...)
+    {
+        //nothing was queued, the slot goes back to the ring
+        captureWriter_->ReleaseSlot(slot.value());
+        throw;
+    }
+
+    captureWriter_->Push(slot.value());
+    return true;
+}
+
+std::vector<uint8_t> Renderer::ReadPixels()
+{
+    if(swapchain_)
+    {
+        throw std::runtime_error("ReadPixels needs an offscreen target, use StartCapture for swapchains");
+    }
+
+    vk::DeviceSize size = vk::DeviceSize(requiredInfo_.extent.width) * requiredInfo_.extent.height * 4;
+    vk::Buffer buffer = createBuffer(size, vk::BufferUsageFlagBits::eTransferDst);
+    bool coherent;
+    vk::DeviceMemory memory = allocateReadbackMem(buffer, coherent);
+    CHECK_NULL(buffer);
+    CHECK_NULL(memory);
+    device_.bindBufferMemory(buffer, memory, 0);
+
+    vk::CommandBuffer readCmdBuf = beginOneTimeCmd();
+
+    //the render pass already left the image in transfer src layout
+    vk::MemoryBarrier renderDone;
+    renderDone.setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
+              .setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+    readCmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eTransfer,
+                               {}, renderDone, nullptr, nullptr);
+
+    vk::BufferImageCopy region;
+    region.setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1))
+          .setImageExtent({requiredInfo_.extent.width, requiredInfo_.extent.height, 1});
+    readCmdBuf.copyImageToBuffer(images_[0], vk::ImageLayout::eTransferSrcOptimal, buffer, region);
+
+    vk::MemoryBarrier toHost;
+    toHost.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+          .setDstAccessMask(vk::AccessFlagBits::eHostRead);
+    readCmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+                               {}, toHost, nullptr, nullptr);
+
+    endOneTimeCmd(readCmdBuf);
+
+    std::vector<uint8_t> pixels(size);
+    void* data = device_.mapMemory(memory, 0, size);
+    if(!coherent)
+    {
+        device_.invalidateMappedMemoryRanges(vk::MappedMemoryRange(memory, 0, VK_WHOLE_SIZE));
+    }
+    memcpy(pixels.data(), data, size);
+    device_.unmapMemory(memory);
+
+    freeMem(memory);
+    device_.destroyBuffer(buffer);
+
+    return pixels;
+}
+
+vk::Image Renderer::createOffscreenImage()
+{
+    vk::ImageCreateInfo info;
+    info.setImageType(vk::ImageType::e2D)
+        .setFormat(requiredInfo_.format.format)
+        .setExtent({requiredInfo_.extent.width, requiredInfo_.extent.height, 1})
+        .setMipLevels(1)
+        .setArrayLayers(1)
+        .setSamples(vk::SampleCountFlagBits::e1)
+        .setTiling(vk::ImageTiling::eOptimal)
+        .setUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc)
+        .setSharingMode(vk::SharingMode::eExclusive)
+        .setInitialLayout(vk::ImageLayout::eUndefined);
+
+    return device_.createImage(info);
+}
+
+void Renderer::recordCaptureCmd(vk::CommandBuffer buf, vk::Image image, vk::Buffer dst)
+{
+    vk::CommandBufferBeginInfo beginInfo;
+    beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+
+    if(buf.begin(&beginInfo) != vk::Result::eSuccess)
+    {
+        throw std::runtime_error("capture command buffer record failed");
+    }
+    DebugUtils::BeginLabel(buf, "capture readback");
+
+    //the semaphore wait already covers the render pass writes
+    vk::ImageMemoryBarrier toTransfer;
+    toTransfer.setImage(image)
+              .setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1))
+              .setOldLayout(vk::ImageLayout::ePresentSrcKHR)
+              .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
+              .setSrcAccessMask({})
+              .setDstAccessMask(vk::AccessFlagBits::eTransferRead)
+              .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+              .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    if(swapchain_)
+    {
+        buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+                            {}, nullptr, nullptr, toTransfer);
+    }
+    else
+    {
+        //the offscreen pass already left the image in transfer src layout, no semaphore in between
+        vk::MemoryBarrier renderDone;
+        renderDone.setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
+                  .setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+        buf.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eTransfer,
+                            {}, renderDone, nullptr, nullptr);
+    }
+
+    vk::BufferImageCopy region;
+    region.setBufferOffset(0)
+          .setBufferRowLength(0)
+          .setBufferImageHeight(0)
+          .setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1))
+          .setImageOffset({0, 0, 0})
+          .setImageExtent({requiredInfo_.extent.width, requiredInfo_.extent.height, 1});
+    buf.copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal, dst, region);
+
+    if(swapchain_)
+    {
+        vk::ImageMemoryBarrier toPresent = toTransfer;
+        toPresent.setOldLayout(vk::ImageLayout::eTransferSrcOptimal)
+                 .setNewLayout(vk::ImageLayout::ePresentSrcKHR)
+                 .setSrcAccessMask(vk::AccessFlagBits::eTransferRead)
+                 .setDstAccessMask({});
+        buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+                            {}, nullptr, nullptr, toPresent);
+    }
+
+    vk::BufferMemoryBarrier toHost;
+    toHost.setBuffer(dst)
+          .setOffset(0)
+          .setSize(VK_WHOLE_SIZE)
+          .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+          .setDstAccessMask(vk::AccessFlagBits::eHostRead)
+          .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+          .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+                        {}, nullptr, toHost, nullptr);
+
+    DebugUtils::EndLabel(buf);
+    buf.end();
+}
+
+void Renderer::StartCapture(const char* path, CaptureFormat format)
+{
+    if(captureWriter_)
+    {
+        throw std::runtime_error("capture already started");
+    }
+    //the offscreen target is always created with transfer src usage
+    if(swapchain_ && !(requiredInfo_.capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc))
+    {
+        throw std::runtime_error("swapchain images can't be used as transfer source");
     }
+    switch(requiredInfo_.format.format)
+    {
+    case vk::Format::eB8G8R8A8Srgb:
+    case vk::Format::eB8G8R8A8Unorm:
+    case vk::Format::eR8G8B8A8Srgb:
+    case vk::Format::eR8G8B8A8Unorm:
+        break;
+    default:
+        throw std::runtime_error("capture only supports 8-bit RGBA/BGRA swapchains");
+    }
+
+    vk::DeviceSize size = vk::DeviceSize(requiredInfo_.extent.width) * requiredInfo_.extent.height * 4;
+
+    std::vector<CaptureWriter::Slot> writerSlots;
+    for(uint32_t i = 0; i < CaptureSlotCount; i ++)
+    {
+        CaptureSlot slot;
+        slot.buffer = createBuffer(size, vk::BufferUsageFlagBits::eTransferDst);
+        slot.memory = allocateReadbackMem(slot.buffer, slot.coherent);
+        CHECK_NULL(slot.buffer);
+        CHECK_NULL(slot.memory);
+        device_.bindBufferMemory(slot.buffer, slot.memory, 0);
+        //stays mapped for the whole capture, the worker reads it in place
+        slot.data = device_.mapMemory(slot.memory, 0, size);
+        slot.cmdBuf = createCmdBuffer();
+        slot.fence = createFence();
+        CHECK_NULL(slot.cmdBuf);
+        CHECK_NULL(slot.fence);
+
+        captureSlots_.push_back(slot);
+        writerSlots.push_back({slot.fence, slot.memory, slot.data, slot.coherent});
+    }
+
+    captureWriter_ = std::make_unique<CaptureWriter>(device_, std::move(writerSlots),
+                                                     requiredInfo_.extent, requiredInfo_.format.format,
+                                                     path, format);
+}
+
+void Renderer::StopCapture()
+{
+    if(!captureWriter_) return;
+
+    //waits for the in-flight slots and flushes them to disk
+    captureWriter_.reset();
+
+    for(auto& slot : captureSlots_)
+    {
+        device_.unmapMemory(slot.memory);
+        freeMem(slot.memory);
+        device_.destroyBuffer(slot.buffer);
+        device_.freeCommandBuffers(cmdPool_, slot.cmdBuf);
+        device_.destroyFence(slot.fence);
+    }
+    captureSlots_.clear();
+}
+
+Mesh Renderer::createMesh(const void* vertexData, vk::DeviceSize vertexSize,
+                          const void* indexData, uint32_t indexCount, vk::IndexType indexType)
+{
+    vk::DeviceSize indexSize = vk::DeviceSize(indexCount) * (indexType == vk::IndexType::eUint16 ? 2 : 4);
+
+    //both streams share one staging buffer, vertices first
+    vk::Buffer staging = createBuffer(vertexSize + indexSize, vk::BufferUsageFlagBits::eTransferSrc);
+    vk::DeviceMemory stagingMem = allocateMem(staging, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, MemoryCategory::Staging);
+    CHECK_NULL(staging);
+    CHECK_NULL(stagingMem);
+    device_.bindBufferMemory(staging, stagingMem, 0);
+
+    auto data = static_cast<char*>(device_.mapMemory(stagingMem, 0, vertexSize + indexSize));
+    memcpy(data, vertexData, vertexSize);
+    memcpy(data + vertexSize, indexData, indexSize);
+    device_.unmapMemory(stagingMem);
+
+    Mesh mesh;
+    mesh.indexCount = indexCount;
+    mesh.indexType = indexType;
+
+    mesh.vertexBuffer = createBuffer(vertexSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer);
+    mesh.vertexMem = allocateMem(mesh.vertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Geometry);
+    CHECK_NULL(mesh.vertexBuffer);
+    CHECK_NULL(mesh.vertexMem);
+    device_.bindBufferMemory(mesh.vertexBuffer, mesh.vertexMem, 0);
+
+    mesh.indexBuffer = createBuffer(indexSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer);
+    mesh.indexMem = allocateMem(mesh.indexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Geometry);
+    CHECK_NULL(mesh.indexBuffer);
+    CHECK_NULL(mesh.indexMem);
+    device_.bindBufferMemory(mesh.indexBuffer, mesh.indexMem, 0);
+
+    vk::CommandBuffer transformCmdBuf = beginOneTimeCmd();
+    DebugUtils::BeginLabel(transformCmdBuf, "mesh upload");
+    transformCmdBuf.copyBuffer(staging, mesh.vertexBuffer, vk::BufferCopy(0, 0, vertexSize));
+    transformCmdBuf.copyBuffer(staging, mesh.indexBuffer, vk::BufferCopy(vertexSize, 0, indexSize));
+    DebugUtils::EndLabel(transformCmdBuf);
+    endOneTimeCmd(transformCmdBuf);
+
+    freeMem(stagingMem);
+    device_.destroyBuffer(staging);
+
+    return mesh;
+}
+
+void Renderer::SetMesh(const Mesh& mesh)
+{
+    mesh_ = mesh;
+}
+
+void Renderer::DestroyMesh(Mesh& mesh)
+{
+    if(mesh_.vertexBuffer == mesh.vertexBuffer)
+    {
+        mesh_ = quadMesh_;
+    }
+    freeMem(mesh.vertexMem);
+    freeMem(mesh.indexMem);
+    device_.destroyBuffer(mesh.vertexBuffer);
+    device_.destroyBuffer(mesh.indexBuffer);
+    mesh = Mesh{};
+}
+
+vk::CommandBuffer Renderer::beginOneTimeCmd()
+{
+    vk::CommandBuffer buf = createCmdBuffer();
+    CHECK_NULL(buf);
+
+    vk::CommandBufferBeginInfo info;
+    info.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+    buf.begin(info);
+
+    return buf;
+}
+
+void Renderer::endOneTimeCmd(vk::CommandBuffer buf)
+{
+    buf.end();
+
+    vk::SubmitInfo submitInfo;
+    submitInfo.setCommandBuffers(buf);
+    graphicQueue_.submit(submitInfo);
+
+    device_.waitIdle();
 
+    device_.freeCommandBuffers(cmdPool_, buf);
 }
 
 vk::Semaphore Renderer::createSemaphore()
@@ -698,46 +1441,124 @@ void Renderer::WaitIdle()
     device_.waitIdle();
 }
 
-vk::Buffer Renderer::createBuffer(vk::BufferUsageFlags flag)
+vk::Buffer Renderer::createBuffer(vk::DeviceSize size, vk::BufferUsageFlags flag)
 {
     vk::BufferCreateInfo info;
     info.setSharingMode(vk::SharingMode::eExclusive)
         .setQueueFamilyIndices(queueIndices_.graphicsIndices.value())
-        .setSize(sizeof(vertices))
+        .setSize(size)
         .setUsage(flag);
 
     return device_.createBuffer(info);
 }
 
-vk::DeviceMemory Renderer::allocateMem(vk::Buffer buffer, vk::MemoryPropertyFlags flag)
+vk::DeviceMemory Renderer::allocateMem(vk::Buffer buffer, vk::MemoryPropertyFlags flag, MemoryCategory category)
 {
-    auto requirement = queryMemInfo(buffer, flag);
+    return allocateMem(device_.getBufferMemoryRequirements(buffer), flag, category);
+}
+
+vk::DeviceMemory Renderer::allocateMem(vk::Image image, vk::MemoryPropertyFlags flag, MemoryCategory category)
+{
+    return allocateMem(device_.getImageMemoryRequirements(image), flag, category);
+}
+
+vk::DeviceMemory Renderer::allocateMem(vk::MemoryRequirements memRequirement, vk::MemoryPropertyFlags flag, MemoryCategory category)
+{
+    auto requirement = queryMemInfo(memRequirement, flag);
+
+    //give streaming resources a chance to go before the driver starts failing or paging
+    vk::DeviceSize overcommit = memoryTelemetry_.Overcommit(requirement.index, requirement.size, memoryHeadroom_);
+    if(overcommit)
+    {
+        uint32_t heap = memoryTelemetry_.Properties().memoryTypes[requirement.index].heapIndex;
+        std::cerr << "Memory heap " << heap << " would be " << overcommit << " bytes over budget" << std::endl;
+        if(evictionHandler_)
+        {
+            vk::DeviceSize released = evictionHandler_(heap, overcommit);
+            if(released < overcommit)
+            {
+                std::cerr << "Memory eviction released only " << released << " bytes" << std::endl;
+            }
+        }
+    }
     
     vk::MemoryAllocateInfo info;
     info.setAllocationSize(requirement.size)
         .setMemoryTypeIndex(requirement.index);
 
+    vk::DeviceMemory memory = device_.allocateMemory(info);
+    memoryTelemetry_.OnAllocate(memory, requirement.size, requirement.index, category);
+    return memory;
+}
 
-    return device_.allocateMemory(info);
+//the CPU reads every byte of a readback, cached memory is much faster to read than
+//write-combined; coherent memory is the fallback on drivers without a cached type
+vk::DeviceMemory Renderer::allocateReadbackMem(vk::Buffer buffer, bool& coherent)
+{
+    auto requirement = device_.getBufferMemoryRequirements(buffer);
+    vk::MemoryPropertyFlags flag = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached;
+    if(!findMemType(requirement, flag))
+    {
+        flag = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+    }
+    auto& property = memoryTelemetry_.Properties();
+    coherent = bool(property.memoryTypes[queryMemInfo(requirement, flag).index].propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent);
+    return allocateMem(requirement, flag, MemoryCategory::Readback);
 }
 
-Renderer::MemRequiredInfo Renderer::queryMemInfo(vk::Buffer buffer, vk::MemoryPropertyFlags flag)
+void Renderer::freeMem(vk::DeviceMemory memory)
 {
-    MemRequiredInfo info;
-    auto property = phyDevice_.getMemoryProperties();
+    if(!memory) return;
+    memoryTelemetry_.OnFree(memory);
+    device_.freeMemory(memory);
+}
 
-    auto requirement = device_.getBufferMemoryRequirements(buffer);
+MemorySnapshot Renderer::GetMemorySnapshot()
+{
+    return memoryTelemetry_.Snapshot();
+}
 
-    info.size = requirement.size;
-    for(int i = 0; i < property.memoryTypeCount; i ++)
+void Renderer::SetMemoryLogInterval(uint32_t frames)
+{
+    memoryLogInterval_ = frames;
+}
+
+void Renderer::SetEvictionHandler(EvictionHandler handler)
+{
+    evictionHandler_ = std::move(handler);
+}
+
+void Renderer::SetMemoryHeadroom(float fraction)
+{
+    memoryHeadroom_ = std::clamp(fraction, 0.0f, 1.0f);
+}
+
+std::optional<uint32_t> Renderer::findMemType(vk::MemoryRequirements requirement, vk::MemoryPropertyFlags flag)
+{
+    auto& property = memoryTelemetry_.Properties();
+
+    //memory types are listed in the driver's order of preference, take the first with every flag
+    for(uint32_t i = 0; i < property.memoryTypeCount; i ++)
     {
         if((requirement.memoryTypeBits & (1 << i))
-            && (property.memoryTypes[i].propertyFlags & (flag)))
+            && (property.memoryTypes[i].propertyFlags & flag) == flag)
         {
-            info.index = i;
+            return i;
         }
     }
+    return std::nullopt;
+}
 
-    return info;
+Renderer::MemRequiredInfo Renderer::queryMemInfo(vk::MemoryRequirements requirement, vk::MemoryPropertyFlags flag)
+{
+    auto index = findMemType(requirement, flag);
+    if(!index)
+    {
+        throw std::runtime_error("no memory type matches the requirements");
+    }
 
+    MemRequiredInfo info;
+    info.index = index.value();
+    info.size = requirement.size;
+    return info;
 }
\ No newline at end of file
@@ -0,0 +1,453 @@
+#include "renderer.hpp"
+#include "mapped_file.hpp"
+#include "check.hpp"
+
+//std
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <string>
+
+namespace
+{
+
+const uint8_t Ktx2Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+struct Ktx2Header
+{
+    uint8_t identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header is 80 bytes");
+
+struct Ktx2Level
+{
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+struct BlockInfo
+{
+    uint32_t bytes = 0;
+    uint32_t width = 1;
+    uint32_t height = 1;
+};
+
+//texel block of the formats KTX2 files are expected to carry, bytes 0 when unknown
+BlockInfo blockInfo(vk::Format format)
+{
+    switch(format)
+    {
+    case vk::Format::eR8Unorm:
+    case vk::Format::eR8Srgb:
+        return {1};
+    case vk::Format::eR8G8Unorm:
+    case vk::Format::eR8G8Srgb:
+    case vk::Format::eR16Unorm:
+    case vk::Format::eR16Sfloat:
+        return {2};
+    case vk::Format::eR8G8B8A8Unorm:
+    case vk::Format::eR8G8B8A8Srgb:
+    case vk::Format::eB8G8R8A8Unorm:
+    case vk::Format::eB8G8R8A8Srgb:
+    case vk::Format::eA2B10G10R10UnormPack32:
+    case vk::Format::eB10G11R11UfloatPack32:
+    case vk::Format::eE5B9G9R9UfloatPack32:
+    case vk::Format::eR16G16Sfloat:
+    case vk::Format::eR32Sfloat:
+        return {4};
+    case vk::Format::eR16G16B16A16Unorm:
+    case vk::Format::eR16G16B16A16Sfloat:
+    case vk::Format::eR32G32Sfloat:
+        return {8};
+    case vk::Format::eR32G32B32A32Sfloat:
+        return {16};
+    case vk::Format::eBc1RgbUnormBlock:
+    case vk::Format::eBc1RgbSrgbBlock:
+    case vk::Format::eBc1RgbaUnormBlock:
+    case vk::Format::eBc1RgbaSrgbBlock:
+    case vk::Format::eBc4UnormBlock:
+    case vk::Format::eBc4SnormBlock:
+    case vk::Format::eEtc2R8G8B8UnormBlock:
+    case vk::Format::eEtc2R8G8B8SrgbBlock:
+    case vk::Format::eEtc2R8G8B8A1UnormBlock:
+    case vk::Format::eEtc2R8G8B8A1SrgbBlock:
+    case vk::Format::eEacR11UnormBlock:
+    case vk::Format::eEacR11SnormBlock:
+        return {8, 4, 4};
+    case vk::Format::eBc2UnormBlock:
+    case vk::Format::eBc2SrgbBlock:
+    case vk::Format::eBc3UnormBlock:
+    case vk::Format::eBc3SrgbBlock:
+    case vk::Format::eBc5UnormBlock:
+    case vk::Format::eBc5SnormBlock:
+    case vk::Format::eBc6HUfloatBlock:
+    case vk::Format::eBc6HSfloatBlock:
+    case vk::Format::eBc7UnormBlock:
+    case vk::Format::eBc7SrgbBlock:
+    case vk::Format::eEtc2R8G8B8A8UnormBlock:
+    case vk::Format::eEtc2R8G8B8A8SrgbBlock:
+    case vk::Format::eEacR11G11UnormBlock:
+    case vk::Format::eEacR11G11SnormBlock:
+    case vk::Format::eAstc4x4UnormBlock:
+    case vk::Format::eAstc4x4SrgbBlock:
+        return {16, 4, 4};
+    default:
+        return {};
+    }
+}
+
+uint32_t fullMipChain(vk::Extent2D extent)
+{
+    uint32_t levels = 1;
+    for(uint32_t size = std::max(extent.width, extent.height); size > 1; size >>= 1) levels ++;
+    return levels;
+}
+
+//"P6 <width> <height> 255" with optional comments, binary RGB after one whitespace
+bool parsePPM(const char* data, size_t size, uint32_t& width, uint32_t& height, size_t& pixelOffset)
+{
+    uint32_t fields[3];
+    size_t pos = 2;
+    if(size < 2 || data[0] != 'P' || data[1] != '6') return false;
+    for(auto& field : fields)
+    {
+        while(pos < size && (isspace(uint8_t(data[pos])) || data[pos] == '#'))
+        {
+            if(data[pos] == '#')
+            {
+                while(pos < size && data[pos] != '\n') pos ++;
+            }
+            else pos ++;
+        }
+        if(pos >= size || !isdigit(uint8_t(data[pos]))) return false;
+        field = 0;
+        while(pos < size && isdigit(uint8_t(data[pos]))) field = field * 10 + (data[pos ++] - '0');
+    }
+    width = fields[0];
+    height = fields[1];
+    pixelOffset = pos + 1;
+    //divided rather than multiplied out, a crafted size can't wrap
+    return fields[2] == 255 && width && height && pixelOffset <= size
+        && (size - pixelOffset) / 3 / width >= height;
+}
+
+}
+
+Texture Renderer::LoadTexture(const char* filename)
+{
+    MappedFile file(filename);
+    const char* data = file.Data();
+
+    uint32_t width, height;
+    size_t pixelOffset;
+    if(parsePPM(data, file.Size(), width, height, pixelOffset))
+    {
+        std::vector<uint8_t> rgba(size_t(width) * height * 4);
+        for(size_t i = 0, j = pixelOffset; i < rgba.size(); i += 4, j += 3)
+        {
+            rgba[i + 0] = data[j + 0];
+            rgba[i + 1] = data[j + 1];
+            rgba[i + 2] = data[j + 2];
+            rgba[i + 3] = 0xFF;
+        }
+        return CreateTexture(rgba.data(), width, height, true);
+    }
+
+    if(file.Size() < sizeof(Ktx2Header) || memcmp(data, Ktx2Identifier, sizeof(Ktx2Identifier)) != 0)
+    {
+        throw std::runtime_error(std::string("unknown texture format: ") + filename);
+    }
+
+    Ktx2Header header;
+    memcpy(&header, data, sizeof(header));
+
+    //BasisU and zstd payloads need a CPU transcode, which is exactly what this path avoids
+    if(header.vkFormat == VK_FORMAT_UNDEFINED || header.supercompressionScheme != 0)
+    {
+        throw std::runtime_error("supercompressed KTX2 textures aren't supported");
+    }
+    if(header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1)
+    {
+        throw std::runtime_error("only single 2D KTX2 images are supported");
+    }
+
+    vk::Format format = vk::Format(header.vkFormat);
+    vk::Extent2D extent(header.pixelWidth, header.pixelHeight);
+    BlockInfo block = blockInfo(format);
+    if(block.bytes == 0)
+    {
+        throw std::runtime_error("unsupported KTX2 format");
+    }
+    if(header.levelCount > fullMipChain(extent))
+    {
+        throw std::runtime_error("KTX2 has more levels than its extent allows");
+    }
+
+    //levelCount 0 asks the loader to generate the chain
+    uint32_t storedLevels = std::max(header.levelCount, 1u);
+    bool generateMips = header.levelCount == 0 && canGenerateMips(format);
+    uint32_t mipLevels = generateMips ? fullMipChain(extent) : storedLevels;
+
+    if(sizeof(Ktx2Header) + storedLevels * sizeof(Ktx2Level) > file.Size())
+    {
+        throw std::runtime_error("KTX2 level index truncated");
+    }
+
+    //pack the levels contiguously, KTX2 already keeps them block and 4 byte aligned
+    std::vector<Ktx2Level> levels(storedLevels);
+    memcpy(levels.data(), data + sizeof(Ktx2Header), storedLevels * sizeof(Ktx2Level));
+
+    std::vector<vk::BufferImageCopy> regions;
+    vk::DeviceSize stagingSize = 0;
+    for(uint32_t i = 0; i < storedLevels; i ++)
+    {
+        uint32_t width = std::max(extent.width >> i, 1u);
+        uint32_t height = std::max(extent.height >> i, 1u);
+        //what copyBufferToImage reads for this level
+        vk::DeviceSize expected = vk::DeviceSize((width + block.width - 1) / block.width)
+                                * ((height + block.height - 1) / block.height) * block.bytes;
+        if(levels[i].byteLength != expected)
+        {
+            throw std::runtime_error("KTX2 level size doesn't match its extent and format");
+        }
+        if(levels[i].byteOffset > file.Size() || levels[i].byteLength > file.Size() - levels[i].byteOffset)
+        {
+            throw std::runtime_error("KTX2 level data truncated");
+        }
+        vk::BufferImageCopy region;
+        region.setBufferOffset(stagingSize)
+              .setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, i, 0, 1))
+              .setImageExtent({width, height, 1});
+        regions.push_back(region);
+        stagingSize += (levels[i].byteLength + 15) & ~vk::DeviceSize(15);
+    }
+
+    std::vector<char> packed(stagingSize);
+    for(uint32_t i = 0; i < storedLevels; i ++)
+    {
+        memcpy(packed.data() + regions[i].bufferOffset, data + levels[i].byteOffset, levels[i].byteLength);
+    }
+
+    return uploadTexture(format, extent, mipLevels, generateMips, packed.data(), stagingSize, regions);
+}
+
+Texture Renderer::CreateTexture(const void* pixels, uint32_t width, uint32_t height, bool srgb)
+{
+    vk::Format format = srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+    vk::Extent2D extent(width, height);
+    bool generateMips = canGenerateMips(format);
+
+    vk::BufferImageCopy region;
+    region.setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1))
+          .setImageExtent({width, height, 1});
+
+    return uploadTexture(format, extent, generateMips ? fullMipChain(extent) : 1, generateMips,
+                         pixels, vk::DeviceSize(width) * height * 4, {region});
+}
+
+void Renderer::DestroyTexture(Texture& texture)
+{
+    device_.destroyImageView(texture.view);
+    device_.destroyImage(texture.image);
+    freeMem(texture.memory);
+    texture = Texture{};
+}
+
+vk::Sampler Renderer::GetSampler(const SamplerDesc& desc)
+{
+    auto it = samplers_.find(desc);
+    if(it != samplers_.end())
+    {
+        return it->second;
+    }
+
+    vk::SamplerCreateInfo info;
+    info.setMagFilter(desc.magFilter)
+        .setMinFilter(desc.minFilter)
+        .setMipmapMode(desc.mipmapMode)
+        .setAddressModeU(desc.addressMode)
+        .setAddressModeV(desc.addressMode)
+        .setAddressModeW(desc.addressMode)
+        .setMinLod(0)
+        .setMaxLod(VK_LOD_CLAMP_NONE)
+        .setAnisotropyEnable(false)
+        .setBorderColor(vk::BorderColor::eFloatOpaqueBlack);
+
+    vk::Sampler sampler = device_.createSampler(info);
+    CHECK_NULL(sampler);
+    samplers_.emplace(desc, sampler);
+    return sampler;
+}
+
+bool Renderer::canGenerateMips(vk::Format format)
+{
+    //block compressed formats never report blit dst, so they keep their stored levels
+    auto required = vk::FormatFeatureFlagBits::eBlitSrc
+                  | vk::FormatFeatureFlagBits::eBlitDst
+                  | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+    auto features = phyDevice_.getFormatProperties(format).optimalTilingFeatures;
+    return (features & required) == required;
+}
+
+Texture Renderer::uploadTexture(vk::Format format, vk::Extent2D extent, uint32_t mipLevels, bool generateMips,
+                                const void* data, vk::DeviceSize size, const std::vector<vk::BufferImageCopy>& regions)
+{
+    if(!(phyDevice_.getFormatProperties(format).optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImage))
+    {
+        throw std::runtime_error("texture format isn't supported by the device");
+    }
+
+    Texture texture;
+    texture.format = format;
+    texture.extent = extent;
+    texture.mipLevels = mipLevels;
+
+    vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+    if(generateMips)
+    {
+        usage |= vk::ImageUsageFlagBits::eTransferSrc;
+    }
+
+    vk::ImageCreateInfo info;
+    info.setImageType(vk::ImageType::e2D)
+        .setFormat(format)
+        .setExtent({extent.width, extent.height, 1})
+        .setMipLevels(mipLevels)
+        .setArrayLayers(1)
+        .setSamples(vk::SampleCountFlagBits::e1)
+        .setTiling(vk::ImageTiling::eOptimal)
+        .setUsage(usage)
+        .setSharingMode(vk::SharingMode::eExclusive)
+        .setInitialLayout(vk::ImageLayout::eUndefined);
+    texture.image = device_.createImage(info);
+    CHECK_NULL(texture.image);
+
+    texture.memory = allocateMem(texture.image, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Texture);
+    CHECK_NULL(texture.memory);
+    device_.bindImageMemory(texture.image, texture.memory, 0);
+
+    vk::Buffer staging = createBuffer(size, vk::BufferUsageFlagBits::eTransferSrc);
+    vk::DeviceMemory stagingMem = allocateMem(staging, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, MemoryCategory::Staging);
+    CHECK_NULL(staging);
+    CHECK_NULL(stagingMem);
+    device_.bindBufferMemory(staging, stagingMem, 0);
+
+    void* mapped = device_.mapMemory(stagingMem, 0, size);
+    memcpy(mapped, data, size);
+    device_.unmapMemory(stagingMem);
+
+    vk::CommandBuffer buf = beginOneTimeCmd();
+    DebugUtils::BeginLabel(buf, "texture upload");
+
+    vk::ImageMemoryBarrier barrier;
+    barrier.setImage(texture.image)
+           .setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, mipLevels, 0, 1))
+           .setOldLayout(vk::ImageLayout::eUndefined)
+           .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+           .setSrcAccessMask({})
+           .setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
+           .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+           .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    buf.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+                        {}, nullptr, nullptr, barrier);
+
+    buf.copyBufferToImage(staging, texture.image, vk::ImageLayout::eTransferDstOptimal, regions);
+
+    if(generateMips)
+    {
+        recordMipChain(buf, texture);
+    }
+    else
+    {
+        barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+               .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+               .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+               .setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+        buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+                            {}, nullptr, nullptr, barrier);
+    }
+
+    DebugUtils::EndLabel(buf);
+    endOneTimeCmd(buf);
+
+    freeMem(stagingMem);
+    device_.destroyBuffer(staging);
+
+    vk::ImageViewCreateInfo viewInfo;
+    viewInfo.setImage(texture.image)
+            .setViewType(vk::ImageViewType::e2D)
+            .setFormat(format)
+            .setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, mipLevels, 0, 1));
+    texture.view = device_.createImageView(viewInfo);
+    CHECK_NULL(texture.view);
+
+    return texture;
+}
+
+void Renderer::recordMipChain(vk::CommandBuffer buf, const Texture& texture)
+{
+    //each level is blitted from the previous one, then handed to the shaders
+    vk::ImageMemoryBarrier barrier;
+    barrier.setImage(texture.image)
+           .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+           .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+
+    int32_t width = int32_t(texture.extent.width);
+    int32_t height = int32_t(texture.extent.height);
+    for(uint32_t i = 1; i < texture.mipLevels; i ++)
+    {
+        barrier.setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, i - 1, 1, 0, 1))
+               .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+               .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
+               .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+               .setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+        buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+                            {}, nullptr, nullptr, barrier);
+
+        int32_t nextWidth = std::max(width / 2, 1);
+        int32_t nextHeight = std::max(height / 2, 1);
+
+        vk::ImageBlit blit;
+        blit.setSrcSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, i - 1, 0, 1))
+            .setSrcOffsets({vk::Offset3D(0, 0, 0), vk::Offset3D(width, height, 1)})
+            .setDstSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, i, 0, 1))
+            .setDstOffsets({vk::Offset3D(0, 0, 0), vk::Offset3D(nextWidth, nextHeight, 1)});
+        buf.blitImage(texture.image, vk::ImageLayout::eTransferSrcOptimal,
+                      texture.image, vk::ImageLayout::eTransferDstOptimal,
+                      blit, vk::Filter::eLinear);
+
+        barrier.setOldLayout(vk::ImageLayout::eTransferSrcOptimal)
+               .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+               .setSrcAccessMask(vk::AccessFlagBits::eTransferRead)
+               .setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+        buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+                            {}, nullptr, nullptr, barrier);
+
+        width = nextWidth;
+        height = nextHeight;
+    }
+
+    barrier.setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, texture.mipLevels - 1, 1, 0, 1))
+           .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+           .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+           .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+           .setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+    buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+                        {}, nullptr, nullptr, barrier);
+}
@@ -0,0 +1,93 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include "renderer.hpp"
+
+// Times init and offscreen frames with validation and debug utils off and on.
+//   bench_debug_utils [frames]
+// Debug utils only show a difference in builds with STEPINTOVULKAN_DEBUG_UTILS.
+
+constexpr uint32_t Width = 1280;
+constexpr uint32_t Height = 720;
+
+using Clock = std::chrono::steady_clock;
+
+struct Result
+{
+    double initMs = 0;
+    double frameUs = 0;
+};
+
+static Result run(const DebugConfig& config, uint32_t frames)
+{
+    Result result;
+
+    Renderer::SetDebugConfig(config);
+    auto initBegin = Clock::now();
+    Renderer::InitOffscreen(Width, Height);
+    auto vertexShader = Renderer::CreateShaderModule("vert.spv");
+    auto fragShader = Renderer::CreateShaderModule("frag.spv");
+    Renderer::CreatePipeline(vertexShader, fragShader);
+    result.initMs = std::chrono::duration<double, std::milli>(Clock::now() - initBegin).count();
+
+    //first frames pay for lazy driver work
+    for(uint32_t i = 0; i < 10; i ++)
+    {
+        Renderer::Render();
+    }
+
+    auto frameBegin = Clock::now();
+    for(uint32_t i = 0; i < frames; i ++)
+    {
+        Renderer::Render();
+    }
+    result.frameUs = std::chrono::duration<double, std::micro>(Clock::now() - frameBegin).count() / frames;
+
+    Renderer::WaitIdle();
+    Renderer::Quit();
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t frames = argc > 1 ? uint32_t(std::atoi(argv[1])) : 500;
+    if(frames == 0) frames = 1;
+
+    struct Case
+    {
+        const char* name;
+        DebugConfig config;
+    };
+    Case cases[] = {
+        {"release", {false, false}},
+        {"validation", {true, false}},
+        {"validation + debug utils", {true, true}},
+    };
+
+    std::cout << "debug utils compiled " << (STEPINTOVULKAN_DEBUG_UTILS ? "in" : "out") << ", "
+              << frames << " frames at " << Width << "x" << Height << std::endl;
+
+    double baseline = 0;
+    for(auto& c : cases)
+    {
+        Result result;
+        try
+        {
+            result = run(c.config, frames);
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << c.name << ": " << e.what() << std::endl;
+            return 77;
+        }
+        if(baseline == 0) baseline = result.frameUs;
+
+        std::cout << std::left << std::setw(26) << c.name << std::right << std::fixed << std::setprecision(1)
+                  << " init " << std::setw(8) << result.initMs << " ms"
+                  << "  frame " << std::setw(8) << result.frameUs << " us"
+                  << "  (" << std::setprecision(2) << result.frameUs / baseline << "x)" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include "draw_list.hpp"
+
+// Checks the draw list sort key and radix sort against std::stable_sort.
+// Needs no Vulkan device.
+
+static int failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    if(!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures ++;
+    }
+}
+
+//radix sorts a copy of keys and compares keys and carried order with a stable sort
+static void checkSort(const std::vector<uint64_t>& keys, const char* what)
+{
+    uint32_t count = uint32_t(keys.size());
+    std::vector<uint64_t> sorted = keys;
+    std::vector<uint32_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::vector<uint64_t> tmpKeys(count);
+    std::vector<uint32_t> tmpOrder(count);
+    DrawList::RadixSort(sorted.data(), order.data(), count, tmpKeys.data(), tmpOrder.data());
+
+    std::vector<uint32_t> expected(count);
+    std::iota(expected.begin(), expected.end(), 0);
+    std::stable_sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+    bool ok = true;
+    for(uint32_t i = 0; i < count; i ++)
+    {
+        ok = ok && order[i] == expected[i] && sorted[i] == keys[expected[i]];
+    }
+    check(ok, what);
+}
+
+int main()
+{
+    std::mt19937_64 rng(1234);
+
+    //depth orders draws sharing state, every higher field outranks it
+    check(DrawList::PackKey(0, 1, 0, 1, 0.25f) < DrawList::PackKey(0, 1, 0, 1, 0.5f), "depth orders equal state");
+    check(DrawList::PackKey(0, 1, 0, 1, 1.0f) < DrawList::PackKey(0, 1, 0, 2, 0.0f), "mesh outranks depth");
+    check(DrawList::PackKey(0, 1, 5, 9, 1.0f) < DrawList::PackKey(0, 2, 0, 0, 0.0f), "pipeline outranks set and mesh");
+    check(DrawList::PackKey(0, 4095, 4095, 65535, 1.0f) < DrawList::PackKey(1, 0, 0, 0, 0.0f), "pass outranks everything");
+    check(DrawList::PackKey(0, 0, 0, 0, -1.0f) == DrawList::PackKey(0, 0, 0, 0, 0.0f), "depth clamps below 0");
+    check(DrawList::PackKey(0, 0, 0, 0, 2.0f) == DrawList::PackKey(0, 0, 0, 0, 1.0f), "depth clamps above 1");
+    check(DrawList::PackKey(99, 0, 0, 0, 0.0f) == DrawList::PackKey(15, 0, 0, 0, 0.0f), "pass clamps to its field");
+
+    //one state, depth only: bytes 3 to 7 are shared and skipped, an odd pass count ends in the temporaries
+    {
+        std::vector<uint64_t> keys;
+        std::uniform_real_distribution<float> depth(0, 1);
+        for(int i = 0; i < 1000; i ++) keys.push_back(DrawList::PackKey(2, 7, 3, 11, depth(rng)));
+        checkSort(keys, "depth only keys");
+    }
+
+    //only the low byte differs, a single scatter pass
+    {
+        std::vector<uint64_t> keys;
+        for(int i = 0; i < 500; i ++) keys.push_back(DrawList::PackKey(0, 1, 1, 1, 0.0f) | (rng() & 0xFF));
+        checkSort(keys, "single byte keys");
+    }
+
+    //few distinct states with depth, plenty of equal keys to check stability
+    {
+        std::vector<uint64_t> keys;
+        for(int i = 0; i < 2000; i ++)
+        {
+            keys.push_back(DrawList::PackKey(uint32_t(rng() % 3), uint32_t(rng() % 4), 0, uint32_t(rng() % 5),
+                                             float(rng() % 8) / 8));
+        }
+        checkSort(keys, "mixed state keys");
+    }
+
+    //every byte random
+    {
+        std::vector<uint64_t> keys;
+        for(int i = 0; i < 2000; i ++) keys.push_back(rng());
+        checkSort(keys, "random keys");
+    }
+
+    checkSort({}, "empty");
+    checkSort({42}, "single key");
+
+    if(failures)
+    {
+        return 1;
+    }
+    std::cout << "draw list ok" << std::endl;
+    return 0;
+}
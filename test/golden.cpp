@@ -0,0 +1,562 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include "renderer.hpp"
+
+// Renders a deterministic scene offscreen and compares it with a stored reference.
+//   golden <scene> <data dir> [<reference.ppm> [--update]]
+// Without a reference only the scene's own checks run.
+// Exits with 77 when no Vulkan instance or device can be created so CTest marks it skipped.
+
+constexpr uint32_t Width = 128;
+constexpr uint32_t Height = 96;
+
+//per channel difference still counted as a match
+constexpr int Tolerance = 3;
+//fraction of pixels allowed to exceed the tolerance, covers edge rasterization differences
+constexpr double MaxBadRatio = 0.005;
+
+struct Image
+{
+    uint32_t width = 0, height = 0;
+    std::vector<uint8_t> rgb;
+};
+
+static bool readPPM(const std::string& filename, Image& image)
+{
+    std::ifstream file(filename, std::ios::binary | std::ios::in);
+    std::string magic;
+    int maxValue;
+    file >> magic >> image.width >> image.height >> maxValue;
+    if(!file || magic != "P6" || maxValue != 255) return false;
+    file.get();
+
+    image.rgb.resize(size_t(image.width) * image.height * 3);
+    file.read(reinterpret_cast<char*>(image.rgb.data()), image.rgb.size());
+    return bool(file);
+}
+
+static void writePPM(const std::string& filename, const Image& image)
+{
+    std::ofstream file(filename, std::ios::binary | std::ios::out);
+    file << "P6\n" << image.width << " " << image.height << "\n255\n";
+    file.write(reinterpret_cast<const char*>(image.rgb.data()), image.rgb.size());
+}
+
+static void createDefaultPipeline()
+{
+    auto vertexShader = Renderer::CreateShaderModule("vert.spv");
+    auto fragShader = Renderer::CreateShaderModule("frag.spv");
+    Renderer::CreatePipeline(vertexShader, fragShader);
+}
+
+//same size and few enough pixels over the per channel tolerance
+static bool matches(const std::string& name, const Image& actual, const Image& expected)
+{
+    if(expected.width != actual.width || expected.height != actual.height)
+    {
+        std::cerr << "reference is " << expected.width << "x" << expected.height
+                  << ", rendered " << actual.width << "x" << actual.height << std::endl;
+        return false;
+    }
+
+    size_t badPixels = 0;
+    int maxDiff = 0;
+    for(size_t i = 0; i < actual.rgb.size(); i += 3)
+    {
+        int pixelDiff = 0;
+        for(size_t c = 0; c < 3; c ++)
+        {
+            pixelDiff = std::max(pixelDiff, std::abs(int(actual.rgb[i + c]) - int(expected.rgb[i + c])));
+        }
+        maxDiff = std::max(maxDiff, pixelDiff);
+        if(pixelDiff > Tolerance) badPixels ++;
+    }
+
+    double badRatio = double(badPixels) / (size_t(actual.width) * actual.height);
+    std::cout << name << ": " << badPixels << " pixels over tolerance, max diff " << maxDiff << std::endl;
+    return badRatio <= MaxBadRatio;
+}
+
+static void sceneQuad(const std::string&)
+{
+    createDefaultPipeline();
+    Renderer::Render();
+}
+
+//the built-in quad round-tripped through meshconv, must match the quad scene
+static void sceneMesh(const std::string& dataDir)
+{
+    createDefaultPipeline();
+    Mesh mesh = Renderer::LoadMesh((dataDir + "/quad.mesh").c_str());
+    Renderer::SetMesh(mesh);
+    Renderer::Render();
+    Renderer::WaitIdle();
+    Renderer::DestroyMesh(mesh);
+}
+
+//two meshes submitted interleaved, sorting must group them into one bind each
+static void sceneDrawList(const std::string& dataDir)
+{
+    createDefaultPipeline();
+    Mesh meshA = Renderer::LoadMesh((dataDir + "/quad.mesh").c_str());
+    Mesh meshB = Renderer::LoadMesh((dataDir + "/quad.mesh").c_str());
+    Renderer::Submit(meshA, 0, 0.75f);
+    Renderer::Submit(meshB, 0, 0.25f);
+    Renderer::Submit(meshA, 0, 0.5f);
+    Renderer::Render();
+    Renderer::WaitIdle();
+    Renderer::DestroyMesh(meshA);
+    Renderer::DestroyMesh(meshB);
+
+    auto stats = Renderer::GetDrawStats();
+    std::cout << "draws " << stats.draws << ", pipeline binds " << stats.pipelineBinds
+              << ", vertex binds " << stats.vertexBufferBinds << ", index binds " << stats.indexBufferBinds
+              << ", sort " << stats.sortMicroseconds << "us" << std::endl;
+    if(stats.draws != 3 || stats.pipelineBinds != 1 || stats.vertexBufferBinds != 2 || stats.indexBufferBinds != 2)
+    {
+        throw std::runtime_error("redundant state changes were recorded");
+    }
+}
+
+//one mesh placed three times through instance records and a pixel space camera
+static void sceneInstances(const std::string& dataDir)
+{
+    createDefaultPipeline();
+    Mesh mesh = Renderer::LoadMesh((dataDir + "/quad.mesh").c_str());
+    Renderer::SetCamera(Ortho2D(0, float(Width), 0, float(Height)));
+
+    InstanceSpan instances = Renderer::AllocateInstances(3);
+    InstanceData* data = instances.data;
+    data[0] = InstanceData{};
+    data[0].position[0] = 32;
+    data[0].position[1] = 48;
+    data[0].scale[0] = data[0].scale[1] = 40;
+
+    data[1] = InstanceData{};
+    data[1].position[0] = 96;
+    data[1].position[1] = 32;
+    data[1].scale[0] = 32;
+    data[1].scale[1] = 24;
+    data[1].rotation = 1.5707963f;
+    data[1].color = PackColor(1, 0.5f, 0.5f);
+
+    data[2] = InstanceData{};
+    data[2].position[0] = 96;
+    data[2].position[1] = 72;
+    data[2].scale[0] = data[2].scale[1] = 24;
+    data[2].rotation = 0.7853982f;
+    data[2].color = PackColor(0.5f, 1, 1);
+
+    Renderer::Submit(mesh, instances);
+    Renderer::Render();
+    Renderer::WaitIdle();
+    Renderer::DestroyMesh(mesh);
+
+    //the mapped buffers can't be resized under handed out spans
+    bool rejected = false;
+    try
+    {
+        Renderer::SetInstanceCapacity(1 << 20);
+    }
+    catch(const std::runtime_error&)
+    {
+        rejected = true;
+    }
+    if(!rejected)
+    {
+        throw std::runtime_error("SetInstanceCapacity accepted a resize after Init");
+    }
+}
+
+//quad streamed into undersized buffers so both grow on the GPU, then one vertex
+//moved with a partial update on the next frame
+static void sceneDynamic(const std::string&)
+{
+    createDefaultPipeline();
+    MeshVertex vertices[] = {
+        {{-0.5f, -0.5f}, {1, 0, 0, 1}},
+        {{ 0.5f, -0.5f}, {0, 1, 0, 1}},
+        {{ 0.5f,  0.5f}, {0, 0, 1, 1}},
+        {{-0.5f,  0.5f}, {0, 0, 1, 1}},
+    };
+    uint16_t indices[] = {0, 1, 2, 0, 2, 3};
+
+    DynamicMesh mesh = Renderer::CreateDynamicMesh(2 * sizeof(MeshVertex), 3 * sizeof(uint16_t), vk::IndexType::eUint16);
+    Renderer::UpdateGeometry(mesh.vertices, 0, vertices, 2 * sizeof(MeshVertex));
+    Renderer::UpdateGeometry(mesh.vertices, 2 * sizeof(MeshVertex), vertices + 2, 2 * sizeof(MeshVertex));
+    Renderer::UpdateGeometry(mesh.indices, 0, indices, sizeof(indices));
+    mesh.indexCount = 6;
+    Renderer::Submit(mesh);
+    Renderer::Render();
+
+    vertices[2].position[0] = vertices[2].position[1] = 0.75f;
+    Renderer::UpdateGeometry(mesh.vertices, 2 * sizeof(MeshVertex), vertices + 2, sizeof(MeshVertex));
+    Renderer::Submit(mesh);
+    Renderer::Render();
+    Renderer::WaitIdle();
+
+    if(mesh.vertices.capacity < sizeof(vertices) || mesh.indices.capacity < sizeof(indices))
+    {
+        throw std::runtime_error("geometry buffers didn't grow");
+    }
+    Renderer::DestroyDynamicMesh(mesh);
+}
+
+//a vertex written twice in one frame, the second write must win
+static void sceneOverwrite(const std::string&)
+{
+    createDefaultPipeline();
+    MeshVertex vertices[] = {
+        {{-0.5f, -0.5f}, {1, 0, 0, 1}},
+        {{ 0.5f, -0.5f}, {0, 1, 0, 1}},
+        {{ 0.75f, 0.75f}, {1, 1, 1, 1}},
+        {{-0.5f,  0.5f}, {0, 0, 1, 1}},
+    };
+    uint16_t indices[] = {0, 1, 2, 0, 2, 3};
+    MeshVertex fixed = {{0.5f, 0.5f}, {0, 0, 1, 1}};
+
+    DynamicMesh mesh = Renderer::CreateDynamicMesh(sizeof(vertices), sizeof(indices), vk::IndexType::eUint16);
+    Renderer::UpdateGeometry(mesh.vertices, 0, vertices, sizeof(vertices));
+    Renderer::UpdateGeometry(mesh.indices, 0, indices, sizeof(indices));
+    Renderer::UpdateGeometry(mesh.vertices, 2 * sizeof(MeshVertex), &fixed, sizeof(fixed));
+    mesh.indexCount = 6;
+    Renderer::Submit(mesh);
+    Renderer::Render();
+    Renderer::WaitIdle();
+    Renderer::DestroyDynamicMesh(mesh);
+}
+
+//single level KTX2 with the level data at byte 112, payload bytes of zeros after it
+static void writeKtx2(const std::string& filename, uint32_t supercompression,
+                      uint64_t levelOffset, uint64_t levelLength, size_t payload)
+{
+    const uint8_t identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+    //vkFormat R8G8B8A8_UNORM, typeSize, 4x4, depth, layers, faces, levels, supercompression
+    const uint32_t fields[9] = {37, 1, 4, 4, 0, 0, 1, 1, supercompression};
+    std::vector<char> data(112 + payload, 0);
+    memcpy(data.data(), identifier, sizeof(identifier));
+    memcpy(data.data() + 12, fields, sizeof(fields));
+    memcpy(data.data() + 80, &levelOffset, sizeof(levelOffset));
+    memcpy(data.data() + 88, &levelLength, sizeof(levelLength));
+    std::ofstream file(filename, std::ios::binary | std::ios::out);
+    file.write(data.data(), data.size());
+}
+
+static void expectRejected(const std::string& filename, const char* what)
+{
+    try
+    {
+        Texture texture = Renderer::LoadTexture(filename.c_str());
+        Renderer::DestroyTexture(texture);
+    }
+    catch(const std::runtime_error& e)
+    {
+        std::cout << what << ": " << e.what() << std::endl;
+        return;
+    }
+    throw std::runtime_error(std::string("LoadTexture accepted ") + what);
+}
+
+//texture loading and sampler caching, nothing is drawn
+static void sceneTexture(const std::string& dataDir)
+{
+    std::vector<uint8_t> pixels(64 * 32 * 4, 0x80);
+    Texture created = Renderer::CreateTexture(pixels.data(), 64, 32, false);
+    if(created.mipLevels != 7)
+    {
+        throw std::runtime_error("CreateTexture didn't build the full mip chain");
+    }
+    Renderer::DestroyTexture(created);
+
+    Texture ppm = Renderer::LoadTexture((dataDir + "/quad.ppm").c_str());
+    if(ppm.extent.width != Width || ppm.extent.height != Height || ppm.mipLevels != 8)
+    {
+        throw std::runtime_error("PPM texture has the wrong extent or mip chain");
+    }
+    Renderer::DestroyTexture(ppm);
+
+    writeKtx2("texture_valid.ktx2", 0, 112, 64, 64);
+    Texture ktx = Renderer::LoadTexture("texture_valid.ktx2");
+    if(ktx.extent.width != 4 || ktx.extent.height != 4 || ktx.mipLevels != 1)
+    {
+        throw std::runtime_error("KTX2 texture has the wrong extent or levels");
+    }
+    Renderer::DestroyTexture(ktx);
+
+    writeKtx2("texture_truncated.ktx2", 0, 112, 64, 40);
+    expectRejected("texture_truncated.ktx2", "truncated level");
+    writeKtx2("texture_wrapped.ktx2", 0, ~uint64_t(0) - 15, 64, 64);
+    expectRejected("texture_wrapped.ktx2", "wrapping level offset");
+    writeKtx2("texture_short.ktx2", 0, 112, 32, 64);
+    expectRejected("texture_short.ktx2", "short level");
+    writeKtx2("texture_zstd.ktx2", 2, 112, 64, 64);
+    expectRejected("texture_zstd.ktx2", "supercompressed");
+
+    SamplerDesc linear;
+    SamplerDesc nearest;
+    nearest.magFilter = nearest.minFilter = vk::Filter::eNearest;
+    if(Renderer::GetSampler(linear) != Renderer::GetSampler(SamplerDesc{})
+       || Renderer::GetSampler(linear) == Renderer::GetSampler(nearest))
+    {
+        throw std::runtime_error("GetSampler didn't cache by description");
+    }
+}
+
+//telemetry follows a mesh's allocations, and a zero headroom makes every allocation evict;
+//nothing is drawn
+static void sceneMemory(const std::string& dataDir)
+{
+    auto geometry = [] { return Renderer::GetMemorySnapshot().categories[size_t(MemoryCategory::Geometry)]; };
+    auto usage = [] {
+        vk::DeviceSize total = 0;
+        for(auto& heap : Renderer::GetMemorySnapshot().heaps) total += heap.usage;
+        return total;
+    };
+    auto before = geometry();
+    auto usageBefore = usage();
+    Mesh mesh = Renderer::LoadMesh((dataDir + "/quad.mesh").c_str());
+    auto loaded = geometry();
+    if(loaded.allocationCount != before.allocationCount + 2 || loaded.liveBytes <= before.liveBytes)
+    {
+        throw std::runtime_error("LoadMesh allocations weren't tracked");
+    }
+    //no frame ran, so the budget wasn't re-read and usage moved by our own bytes only
+    if(usage() != usageBefore + (loaded.liveBytes - before.liveBytes))
+    {
+        throw std::runtime_error("heap usage didn't follow allocations between budget refreshes");
+    }
+    Renderer::DestroyMesh(mesh);
+    auto destroyed = geometry();
+    if(destroyed.allocationCount != before.allocationCount || destroyed.liveBytes != before.liveBytes)
+    {
+        throw std::runtime_error("DestroyMesh frees weren't tracked");
+    }
+
+    uint32_t evictions = 0;
+    Renderer::SetEvictionHandler([&](uint32_t, vk::DeviceSize) -> vk::DeviceSize { evictions ++; return 0; });
+    Renderer::SetMemoryHeadroom(0);
+    mesh = Renderer::LoadMesh((dataDir + "/quad.mesh").c_str());
+    Renderer::SetMemoryHeadroom(0.9f);
+    Renderer::SetEvictionHandler(nullptr);
+    Renderer::DestroyMesh(mesh);
+    std::cout << "evictions " << evictions << std::endl;
+    if(evictions == 0)
+    {
+        throw std::runtime_error("eviction handler didn't run over the budget threshold");
+    }
+}
+
+//offscreen frames streamed through the capture ring, the last file must match the quad
+static void sceneCapture(const std::string& dataDir)
+{
+    createDefaultPipeline();
+
+    constexpr int Frames = 3;
+    std::vector<std::string> files;
+    for(int i = 0; i < Frames; i ++)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "capture_%06d.ppm", i);
+        files.push_back(name);
+        std::remove(name);
+    }
+
+    Renderer::StartCapture("capture", CaptureFormat::PPM);
+    for(int i = 0; i < Frames; i ++)
+    {
+        Renderer::Render();
+    }
+    //flushes every queued frame to disk
+    Renderer::StopCapture();
+
+    //the ring has a slot per frame here, so nothing was dropped
+    Image captured;
+    for(auto& file : files)
+    {
+        if(!readPPM(file, captured))
+        {
+            throw std::runtime_error("capture didn't write " + file);
+        }
+    }
+    Image expected;
+    if(!readPPM(dataDir + "/quad.ppm", expected))
+    {
+        throw std::runtime_error("can't read the quad reference");
+    }
+    if(!matches(files.back(), captured, expected))
+    {
+        throw std::runtime_error(files.back() + " doesn't match the quad reference");
+    }
+}
+
+//a blend variant compiled by the pipeline manager workers, drawn over the clear color
+static void sceneAdditive(const std::string&)
+{
+    auto vertexShader = Renderer::CreateShaderModule("vert.spv");
+    auto fragShader = Renderer::CreateShaderModule("frag.spv");
+    Renderer::CreatePipeline(vertexShader, fragShader);
+
+    PipelineDesc desc;
+    desc.vertexShader = vertexShader;
+    desc.fragShader = fragShader;
+    desc.blend = BlendMode::Additive;
+    Renderer::SetPipeline(desc);
+    Renderer::WaitPipelines();
+    Renderer::Render();
+}
+
+//a specialization constant variant, shader.frag's tint halves the quad colors
+static void sceneTint(const std::string&)
+{
+    auto vertexShader = Renderer::CreateShaderModule("vert.spv");
+    auto fragShader = Renderer::CreateShaderModule("frag.spv");
+    Renderer::CreatePipeline(vertexShader, fragShader);
+
+    float tint = 0.5f;
+    uint32_t bits;
+    std::memcpy(&bits, &tint, sizeof(bits));
+
+    PipelineDesc desc;
+    desc.vertexShader = vertexShader;
+    desc.fragShader = fragShader;
+    desc.constants.push_back({0, bits});
+    Renderer::SetPipeline(desc);
+    Renderer::WaitPipelines();
+    Renderer::Render();
+}
+
+//scenes get the directory holding their input assets
+static const std::map<std::string, void(*)(const std::string&)> scenes
+{
+    {"quad", sceneQuad},
+    {"mesh", sceneMesh},
+    {"additive", sceneAdditive},
+    {"drawlist", sceneDrawList},
+    {"instances", sceneInstances},
+    {"dynamic", sceneDynamic},
+    {"overwrite", sceneOverwrite},
+    {"texture", sceneTexture},
+    {"memory", sceneMemory},
+    {"capture", sceneCapture},
+    {"tint", sceneTint},
+};
+
+//only a missing loader, driver or device is a skip, anything failing after that is a regression
+static bool hasVulkanDevice()
+{
+    try
+    {
+        vk::ApplicationInfo appInfo;
+        appInfo.setApiVersion(VK_API_VERSION_1_1);
+        vk::InstanceCreateInfo info;
+        info.setPApplicationInfo(&appInfo);
+        vk::UniqueInstance instance = vk::createInstanceUnique(info);
+        bool found = !instance->enumeratePhysicalDevices().empty();
+        if(!found)
+        {
+            std::cerr << "skipped, no Vulkan device" << std::endl;
+        }
+        return found;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "skipped, no usable Vulkan instance: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 3)
+    {
+        std::cerr << "usage: golden <scene> <data dir> [<reference.ppm> [--update]]" << std::endl;
+        return 1;
+    }
+
+    std::string sceneName = argv[1];
+    std::string dataDir = argv[2];
+    std::string reference = argc > 3 ? argv[3] : "";
+    bool update = argc > 4 && std::strcmp(argv[4], "--update") == 0;
+
+    auto scene = scenes.find(sceneName);
+    if(scene == scenes.end())
+    {
+        std::cerr << "unknown scene " << sceneName << std::endl;
+        return 1;
+    }
+
+    if(!hasVulkanDevice())
+    {
+        return 77;
+    }
+    try
+    {
+        Renderer::InitOffscreen(Width, Height);
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "init failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        scene->second(dataDir);
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << sceneName << " failed: " << e.what() << std::endl;
+        return 1;
+    }
+    if(reference.empty())
+    {
+        Renderer::WaitIdle();
+        Renderer::Quit();
+        return 0;
+    }
+
+    auto rgba = Renderer::ReadPixels();
+    Renderer::WaitIdle();
+    Renderer::Quit();
+
+    Image actual;
+    actual.width = Width;
+    actual.height = Height;
+    actual.rgb.resize(size_t(Width) * Height * 3);
+    for(size_t i = 0, j = 0; i < rgba.size(); i += 4, j += 3)
+    {
+        actual.rgb[j + 0] = rgba[i + 0];
+        actual.rgb[j + 1] = rgba[i + 1];
+        actual.rgb[j + 2] = rgba[i + 2];
+    }
+
+    if(update)
+    {
+        writePPM(reference, actual);
+        std::cout << "reference written to " << reference << std::endl;
+        return 0;
+    }
+
+    Image expected;
+    if(!readPPM(reference, expected))
+    {
+        std::cerr << "can't read reference " << reference << std::endl;
+        return 1;
+    }
+    if(!matches(sceneName, actual, expected))
+    {
+        //left in the working directory for inspection
+        writePPM(sceneName + "_actual.ppm", actual);
+        std::cerr << sceneName << " doesn't match " << reference << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
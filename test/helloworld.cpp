@@ -2,7 +2,7 @@
 #include "renderer.hpp"
 #include "SDL.h"
 #include "SDL_vulkan.h"
-int main(int, char**)
+int main(int argc, char** argv)
 {
     SDL_Init(SDL_INIT_EVERYTHING);
     SDL_Window* window = SDL_CreateWindow("hello world",
@@ -15,6 +15,14 @@ int main(int, char**)
     auto fragShader = Renderer::CreateShaderModule("frag.spv");
 
     Renderer::CreatePipeline(vertexShader, fragShader);
+
+    //optionally draw a mesh converted by meshconv instead of the built-in quad
+    Mesh mesh;
+    if(argc > 1)
+    {
+        mesh = Renderer::LoadMesh(argv[1]);
+        Renderer::SetMesh(mesh);
+    }
     
     bool isquit = false;
     SDL_Event event;
@@ -29,6 +37,11 @@ int main(int, char**)
     }
     
     Renderer::WaitIdle();
+
+    if(mesh.vertexBuffer)
+    {
+        Renderer::DestroyMesh(mesh);
+    }
     
     Renderer::Quit();
     std::cout << "hello test" << std::endl;
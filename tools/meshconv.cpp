@@ -0,0 +1,352 @@
+#include "mesh.hpp"
+
+//std
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// Offline converter producing the .mesh files Renderer::LoadMesh() maps.
+//   meshconv <input.obj> <output.mesh>
+//
+// OBJ positions keep x and y, optional "v x y z r g b" vertex colors are kept,
+// anything else is white. Faces are fan-triangulated.
+// The index stream is reordered for the post-transform vertex cache, vertices are
+// then renumbered in first-use order for fetch locality, and the index size is 16 bit
+// whenever every vertex is addressable with it.
+
+namespace
+{
+
+struct Geometry
+{
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+bool loadObj(const std::string& filename, Geometry& geometry)
+{
+    std::ifstream file(filename);
+    if(!file) return false;
+
+    std::string line;
+    while(std::getline(file, line))
+    {
+        std::istringstream stream(line);
+        std::string tag;
+        stream >> tag;
+        if(tag == "v")
+        {
+            float x = 0, y = 0, z = 0;
+            MeshVertex vertex{{0, 0}, {1, 1, 1, 1}};
+            stream >> x >> y >> z;
+            vertex.position[0] = x;
+            vertex.position[1] = y;
+            float r, g, b;
+            if(stream >> r >> g >> b)
+            {
+                vertex.color[0] = r;
+                vertex.color[1] = g;
+                vertex.color[2] = b;
+            }
+            geometry.vertices.push_back(vertex);
+        }
+        else if(tag == "f")
+        {
+            std::vector<uint32_t> polygon;
+            std::string corner;
+            while(stream >> corner)
+            {
+                //"v", "v/vt", "v//vn" or "v/vt/vn", only the position index matters
+                std::string position = corner.substr(0, corner.find('/'));
+                long index = 0;
+                size_t parsed = 0;
+                try
+                {
+                    index = std::stol(position, &parsed);
+                }
+                catch(const std::exception&)
+                {
+                    parsed = 0;
+                }
+                if(parsed == 0 || parsed != position.size())
+                {
+                    std::cerr << "bad face index: " << line << std::endl;
+                    return false;
+                }
+                long count = long(geometry.vertices.size());
+                index = index < 0 ? count + index : index - 1;
+                if(index < 0 || index >= count)
+                {
+                    std::cerr << "face index out of range: " << line << std::endl;
+                    return false;
+                }
+                polygon.push_back(uint32_t(index));
+            }
+            for(size_t i = 2; i < polygon.size(); i ++)
+            {
+                geometry.indices.insert(geometry.indices.end(), {polygon[0], polygon[i - 1], polygon[i]});
+            }
+        }
+    }
+    return true;
+}
+
+//average vertex transforms per triangle through a FIFO cache, 0.5 is the ideal
+float computeACMR(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+    if(indices.empty()) return 0;
+
+    std::vector<uint64_t> timestamps(vertexCount, 0);
+    uint64_t time = cacheSize + 1;
+    size_t misses = 0;
+    for(uint32_t index : indices)
+    {
+        if(time - timestamps[index] > cacheSize)
+        {
+            timestamps[index] = time ++;
+            misses ++;
+        }
+    }
+    return float(misses) / (indices.size() / 3);
+}
+
+// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation": greedily emits the triangle
+// with the highest score, where a vertex scores higher the more recently it was used
+// and the fewer triangles still reference it.
+constexpr uint32_t CacheSize = 32;
+
+float vertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+    if(remainingTriangles == 0) return -1;
+
+    float score = 0;
+    if(cachePosition >= 0)
+    {
+        if(cachePosition < 3)
+        {
+            //the last triangle's vertices, fixed so there is no reward for repeating it
+            score = 0.75f;
+        }
+        else
+        {
+            float scaler = 1.0f / (CacheSize - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scaler, 1.5f);
+        }
+    }
+    //boost vertices with few triangles left so lone ones don't get stranded
+    score += 2.0f * std::pow(float(remainingTriangles), -0.5f);
+    return score;
+}
+
+std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for(uint32_t index : indices) remaining[index] ++;
+
+    //triangles adjacent to each vertex, packed
+    std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+    for(size_t v = 0; v < vertexCount; v ++) adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for(size_t t = 0; t < triangleCount; t ++)
+    {
+        for(size_t k = 0; k < 3; k ++)
+        {
+            adjacency[fill[indices[t * 3 + k]] ++] = uint32_t(t);
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for(size_t v = 0; v < vertexCount; v ++) score[v] = vertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for(size_t t = 0; t < triangleCount; t ++)
+    {
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+    }
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    std::vector<uint32_t> cache;
+    size_t scanCursor = 0;
+
+    auto bestTriangle = [&]()
+    {
+        //pick among triangles touching the cache, fall back to the next unemitted one
+        int best = -1;
+        float bestScore = -1;
+        for(uint32_t v : cache)
+        {
+            for(uint32_t i = adjacencyOffset[v]; i < adjacencyOffset[v + 1]; i ++)
+            {
+                uint32_t t = adjacency[i];
+                if(!emitted[t] && triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = int(t);
+                }
+            }
+        }
+        if(best < 0)
+        {
+            while(scanCursor < triangleCount && emitted[scanCursor]) scanCursor ++;
+            if(scanCursor < triangleCount) best = int(scanCursor);
+        }
+        return best;
+    };
+
+    for(int t = bestTriangle(); t >= 0; t = bestTriangle())
+    {
+        emitted[t] = true;
+        std::array<uint32_t, 3> tri{indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2]};
+        result.insert(result.end(), tri.begin(), tri.end());
+
+        //remove the triangle from its vertices' adjacency
+        for(uint32_t v : tri)
+        {
+            remaining[v] --;
+            for(uint32_t i = adjacencyOffset[v]; i < adjacencyOffset[v + 1]; i ++)
+            {
+                if(adjacency[i] == uint32_t(t))
+                {
+                    std::swap(adjacency[i], adjacency[adjacencyOffset[v] + remaining[v]]);
+                    break;
+                }
+            }
+        }
+
+        //move the triangle's vertices to the front of the LRU cache
+        std::vector<uint32_t> newCache(tri.begin(), tri.end());
+        for(uint32_t v : cache)
+        {
+            if(v != tri[0] && v != tri[1] && v != tri[2]) newCache.push_back(v);
+        }
+        //everything that was or is in the cache, evicted vertices lose their cache bonus
+        std::vector<uint32_t> changed = newCache;
+        for(size_t i = CacheSize; i < newCache.size(); i ++)
+        {
+            cachePosition[newCache[i]] = -1;
+            score[newCache[i]] = vertexScore(-1, remaining[newCache[i]]);
+        }
+        if(newCache.size() > CacheSize) newCache.resize(CacheSize);
+        cache.swap(newCache);
+
+        //only vertices in the cache or just evicted from it changed score, and only their triangles need rescoring
+        for(size_t i = 0; i < cache.size(); i ++)
+        {
+            cachePosition[cache[i]] = int(i);
+            score[cache[i]] = vertexScore(int(i), remaining[cache[i]]);
+        }
+        for(uint32_t v : changed)
+        {
+            for(uint32_t i = adjacencyOffset[v]; i < adjacencyOffset[v] + remaining[v]; i ++)
+            {
+                uint32_t u = adjacency[i];
+                triangleScore[u] = score[indices[u * 3]] + score[indices[u * 3 + 1]] + score[indices[u * 3 + 2]];
+            }
+        }
+    }
+
+    return result;
+}
+
+//renumber vertices in first-use order, unreferenced vertices are dropped
+void optimizeVertexFetch(Geometry& geometry)
+{
+    constexpr uint32_t unused = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> remap(geometry.vertices.size(), unused);
+    std::vector<MeshVertex> vertices;
+    vertices.reserve(geometry.vertices.size());
+
+    for(uint32_t& index : geometry.indices)
+    {
+        if(remap[index] == unused)
+        {
+            remap[index] = uint32_t(vertices.size());
+            vertices.push_back(geometry.vertices[index]);
+        }
+        index = remap[index];
+    }
+    geometry.vertices.swap(vertices);
+}
+
+bool writeMesh(const std::string& filename, const Geometry& geometry)
+{
+    MeshHeader header{};
+    header.magic = MeshMagic;
+    header.version = MeshVersion;
+    header.vertexCount = uint32_t(geometry.vertices.size());
+    header.vertexStride = sizeof(MeshVertex);
+    header.indexCount = uint32_t(geometry.indices.size());
+    header.indexSize = geometry.vertices.size() <= 0x10000 ? 2 : 4;
+    header.vertexOffset = AlignMeshOffset(sizeof(MeshHeader));
+    header.indexOffset = AlignMeshOffset(header.vertexOffset + uint64_t(header.vertexCount) * header.vertexStride);
+    header.fileSize = header.indexOffset + uint64_t(header.indexCount) * header.indexSize;
+
+    std::vector<char> content(header.fileSize, 0);
+    memcpy(content.data(), &header, sizeof(header));
+    memcpy(content.data() + header.vertexOffset, geometry.vertices.data(), geometry.vertices.size() * sizeof(MeshVertex));
+    if(header.indexSize == 2)
+    {
+        std::vector<uint16_t> narrow(geometry.indices.begin(), geometry.indices.end());
+        memcpy(content.data() + header.indexOffset, narrow.data(), narrow.size() * sizeof(uint16_t));
+    }
+    else
+    {
+        memcpy(content.data() + header.indexOffset, geometry.indices.data(), geometry.indices.size() * sizeof(uint32_t));
+    }
+
+    std::ofstream file(filename, std::ios::binary | std::ios::out | std::ios::trunc);
+    file.write(content.data(), content.size());
+    return bool(file);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    if(argc != 3)
+    {
+        std::cerr << "usage: meshconv <input.obj> <output.mesh>" << std::endl;
+        return 1;
+    }
+
+    Geometry geometry;
+    if(!loadObj(argv[1], geometry))
+    {
+        std::cerr << "can't load " << argv[1] << std::endl;
+        return 1;
+    }
+    if(geometry.indices.empty())
+    {
+        std::cerr << argv[1] << " has no faces" << std::endl;
+        return 1;
+    }
+
+    float before = computeACMR(geometry.indices, geometry.vertices.size(), CacheSize);
+    geometry.indices = optimizeVertexCache(geometry.indices, geometry.vertices.size());
+    float after = computeACMR(geometry.indices, geometry.vertices.size(), CacheSize);
+    optimizeVertexFetch(geometry);
+
+    if(!writeMesh(argv[2], geometry))
+    {
+        std::cerr << "can't write " << argv[2] << std::endl;
+        return 1;
+    }
+
+    std::cout << geometry.vertices.size() << " vertices, " << geometry.indices.size() / 3 << " triangles, "
+              << (geometry.vertices.size() <= 0x10000 ? 16 : 32) << "-bit indices, "
+              << "ACMR " << before << " -> " << after << std::endl;
+    return 0;
+}